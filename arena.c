@@ -0,0 +1,142 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include "profiled_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+/* strictest alignment needed by any of the stored types */
+typedef union
+{
+  long double ad_dbl;
+  long long   ad_int;
+  void       *ad_ptr;
+} arena_align_t;
+
+enum
+{
+  ARENA_CHUNK_SIZE = 16 << 10, // default chunk size
+  ARENA_ALIGN      = __alignof__(arena_align_t),
+};
+
+typedef struct arena_chunk_t arena_chunk_t;
+
+struct arena_chunk_t
+{
+  arena_chunk_t *ac_next;
+  arena_align_t  ac_data[];
+};
+
+struct arena_t
+{
+  size_t         ar_chunk;  // size of new chunks
+  arena_chunk_t *ar_chunks; // list of chunks, latest first
+  char          *ar_pos;    // free space in latest chunk
+  char          *ar_end;
+};
+
+/* ------------------------------------------------------------------------- *
+ * arena_create
+ * ------------------------------------------------------------------------- */
+
+arena_t *
+arena_create(size_t chunk)
+{
+  arena_t *self = calloc(1, sizeof *self);
+
+  self->ar_chunk  = chunk ?: ARENA_CHUNK_SIZE;
+  self->ar_chunks = 0;
+  self->ar_pos    = 0;
+  self->ar_end    = 0;
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * arena_delete  --  release all memory allocated from the arena
+ * ------------------------------------------------------------------------- */
+
+void
+arena_delete(arena_t *self)
+{
+  if( self != 0 )
+  {
+    arena_chunk_t *chunk;
+
+    while( (chunk = self->ar_chunks) != 0 )
+    {
+      self->ar_chunks = chunk->ac_next;
+      free(chunk);
+    }
+    free(self);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * arena_alloc  --  allocate zero filled, suitably aligned memory block
+ * ------------------------------------------------------------------------- */
+
+void *
+arena_alloc(arena_t *self, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+  if( size > self->ar_chunk )
+  {
+    /* oversized blocks get a chunk of their own, which is linked
+     * behind the current one so that its free space is not lost */
+    arena_chunk_t *chunk = malloc(sizeof *chunk + size);
+    arena_chunk_t **tail = self->ar_chunks ? &self->ar_chunks->ac_next
+                                           : &self->ar_chunks;
+    chunk->ac_next = *tail;
+    *tail = chunk;
+    return memset(chunk->ac_data, 0, size);
+  }
+
+  if( size > (size_t)(self->ar_end - self->ar_pos) )
+  {
+    arena_chunk_t *chunk = malloc(sizeof *chunk + self->ar_chunk);
+
+    chunk->ac_next  = self->ar_chunks;
+    self->ar_chunks = chunk;
+    self->ar_pos    = (char *)chunk->ac_data;
+    self->ar_end    = self->ar_pos + self->ar_chunk;
+  }
+
+  void *res = self->ar_pos;
+  self->ar_pos += size;
+
+  return memset(res, 0, size);
+}
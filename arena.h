@@ -0,0 +1,59 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef ARENA_H_
+# define ARENA_H_
+
+# include <stddef.h>
+
+# ifdef __cplusplus
+extern "C" {
+# elif 0
+} /* fool JED indentation ... */
+# endif
+
+typedef struct arena_t arena_t;
+
+/* Bump allocator: memory is handed out from large chunks and can be
+ * released only all at once with arena_delete(). Suitable for data
+ * that is built in one go and then torn down as a whole. */
+
+arena_t *arena_create(size_t chunk);
+void     arena_delete(arena_t *self);
+void    *arena_alloc (arena_t *self, size_t size);
+
+# ifdef __cplusplus
+};
+# endif
+
+#endif /* ARENA_H_ */
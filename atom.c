@@ -0,0 +1,191 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include "profiled_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "atom.h"
+#include "symtab.h"
+
+/* ========================================================================= *
+ * atom_t
+ * ========================================================================= */
+
+typedef struct atom_t atom_t;
+
+struct atom_t
+{
+  size_t at_refs;
+  size_t at_hash;
+  char   at_str[];
+};
+
+/* ------------------------------------------------------------------------- *
+ * atom_of  --  get atom_t from string data pointer
+ * ------------------------------------------------------------------------- */
+
+static inline atom_t *
+atom_of(const char *str)
+{
+  return (atom_t *)(str - offsetof(atom_t, at_str));
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_create_cb
+ * ------------------------------------------------------------------------- */
+
+static
+void *
+atom_create_cb(const char *str)
+{
+  size_t  len  = strlen(str) + 1;
+  atom_t *self = malloc(sizeof *self + len);
+
+  self->at_refs = 0;
+  self->at_hash = symtab_hash(str);
+  memcpy(self->at_str, str, len);
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_delete_cb
+ * ------------------------------------------------------------------------- */
+
+static
+void
+atom_delete_cb(void *self)
+{
+  free(self);
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_getkey_cb
+ * ------------------------------------------------------------------------- */
+
+static
+const char *
+atom_getkey_cb(const void *self)
+{
+  return ((const atom_t *)self)->at_str;
+}
+
+/* ========================================================================= *
+ * atom table
+ * ========================================================================= */
+
+static symtab_t atom_table =
+{
+  .st_new = atom_create_cb,
+  .st_del = atom_delete_cb,
+  .st_key = atom_getkey_cb,
+};
+
+/* ------------------------------------------------------------------------- *
+ * atom_intern  --  get atom for string, adds a reference
+ * ------------------------------------------------------------------------- */
+
+const char *
+atom_intern(const char *str)
+{
+  atom_t *self = symtab_insert(&atom_table, str ?: "");
+  self->at_refs += 1;
+  return self->at_str;
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_find  --  get atom for string if it exists, no reference added
+ * ------------------------------------------------------------------------- */
+
+const char *
+atom_find(const char *str)
+{
+  atom_t *self = symtab_lookup(&atom_table, str ?: "");
+  return self ? self->at_str : 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_ref  --  add reference to atom
+ * ------------------------------------------------------------------------- */
+
+const char *
+atom_ref(const char *atom)
+{
+  if( atom != 0 )
+  {
+    atom_of(atom)->at_refs += 1;
+  }
+  return atom;
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_release  --  drop reference, atom is freed with the last one
+ * ------------------------------------------------------------------------- */
+
+void
+atom_release(const char *atom)
+{
+  if( atom != 0 && --atom_of(atom)->at_refs == 0 )
+  {
+    symtab_remove(&atom_table, atom);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_hash  --  get precalculated hash value of atom
+ * ------------------------------------------------------------------------- */
+
+size_t
+atom_hash(const char *atom)
+{
+  return atom_of(atom)->at_hash;
+}
+
+/* ------------------------------------------------------------------------- *
+ * atom_set  --  replace atom held in *patom, see also xstrset()
+ * ------------------------------------------------------------------------- */
+
+void
+atom_set(const char **patom, const char *str)
+{
+  const char *old = *patom;
+
+  if( old == 0 || str == 0 || strcmp(old, str) )
+  {
+    *patom = str ? atom_intern(str) : 0;
+    atom_release(old);
+  }
+}
@@ -0,0 +1,62 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef ATOM_H_
+# define ATOM_H_
+
+# include <stddef.h>
+
+# ifdef __cplusplus
+extern "C" {
+# elif 0
+} /* fool JED indentation ... */
+# endif
+
+/* Atoms are reference counted strings that are stored only once.
+ *
+ * Two atoms are equal if and only if the pointers are equal, so atom
+ * comparisons do not need strcmp(). The string data must not be
+ * modified and it stays valid until the last reference is released. */
+
+const char *atom_intern (const char *str);
+const char *atom_find   (const char *str);
+const char *atom_ref    (const char *atom);
+void        atom_release(const char *atom);
+size_t      atom_hash   (const char *atom);
+void        atom_set    (const char **patom, const char *str);
+
+# ifdef __cplusplus
+};
+# endif
+
+#endif /* ATOM_H_ */
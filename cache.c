@@ -0,0 +1,508 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include "profiled_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "libprofile-internal.h"
+#include "xutil.h"
+
+#include "logging.h"
+
+/* ========================================================================= *
+ * Cached Profile Data
+ *
+ * When enabled by the application, the values of all profiles are
+ * fetched with one get_all method call and further reads are served
+ * from local copies. The copies are kept up to date by the profile
+ * tracker, which feeds the changes from profile_changed signals here.
+ *
+ * Without tracking there is nothing to keep the copies coherent, so
+ * the cache is used only while the tracker is connected.
+ * ========================================================================= */
+
+typedef struct
+{
+  char           *cp_name;   // profile name
+  profileval_t   *cp_vals;   // values, sorted by key
+  profiletyped_t *cp_typed;  // values in typed form, same order
+  size_t          cp_count;
+} cacheprof_t;
+
+/* Has application enabled caching */
+static bool         profile_cache_on     = FALSE;
+
+/* Has the cache been filled, or has filling it failed */
+static int          profile_cache_primed = 0;
+
+/* Currently active profile, NULL if not known */
+static char        *profile_cache_active = 0;
+
+/* Values of each profile */
+static cacheprof_t *profile_cache_prof   = 0;
+static size_t       profile_cache_profs  = 0;
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_compare_cb  --  order values by key
+ * ------------------------------------------------------------------------- */
+
+static
+int
+profile_cache_compare_cb(const void *a, const void *b)
+{
+  const profileval_t *x = a;
+  const profileval_t *y = b;
+  return strcmp(x->pv_key, y->pv_key);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_parse  --  store value in typed form
+ *
+ * Done once when a value is cached, so that the profile_get_value_as_xxx()
+ * functions do not need to parse the string on every read.
+ * ------------------------------------------------------------------------- */
+
+static
+void
+profile_cache_parse(profiletyped_t *typed, const char *val)
+{
+  typed->tv_bool = profile_parse_bool(val);
+  typed->tv_int  = profile_parse_int(val);
+  typed->tv_dbl  = profile_parse_double(val);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_find_profile  --  locate cached profile
+ * ------------------------------------------------------------------------- */
+
+static
+cacheprof_t *
+profile_cache_find_profile(const char *profile)
+{
+  if( xstrnull(profile) )
+  {
+    // empty name refers to currently active profile
+    if( (profile = profile_cache_active) == 0 )
+    {
+      return 0;
+    }
+  }
+
+  for( size_t i = 0; i < profile_cache_profs; ++i )
+  {
+    if( !strcmp(profile_cache_prof[i].cp_name, profile) )
+    {
+      return &profile_cache_prof[i];
+    }
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_find_value  --  locate cached value
+ * ------------------------------------------------------------------------- */
+
+static
+profileval_t *
+profile_cache_find_value(cacheprof_t *prof, const char *key)
+{
+  profileval_t tmp = { .pv_key = (char *)key };
+
+  return bsearch(&tmp, prof->cp_vals, prof->cp_count,
+                 sizeof *prof->cp_vals, profile_cache_compare_cb);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_flush  --  forget all cached data
+ * ------------------------------------------------------------------------- */
+
+void
+profile_cache_flush(void)
+{
+  for( size_t i = 0; i < profile_cache_profs; ++i )
+  {
+    free(profile_cache_prof[i].cp_name);
+    profileval_free_vector(profile_cache_prof[i].cp_vals);
+    free(profile_cache_prof[i].cp_typed);
+  }
+  free(profile_cache_prof);
+  profile_cache_prof  = 0;
+  profile_cache_profs = 0;
+
+  free(profile_cache_active);
+  profile_cache_active = 0;
+
+  profile_cache_primed = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_prime  --  fill cache with one method call
+ * ------------------------------------------------------------------------- */
+
+static
+bool
+profile_cache_prime(void)
+{
+  profileall_t *all = 0;
+
+  if( profile_cache_primed == 0 )
+  {
+    // do not retry on every read if profiled is not reachable,
+    // the cache is flushed when the connection or profiled changes
+    profile_cache_primed = -1;
+
+    if( (all = profile_get_all()) != 0 && all->pa_active != 0 )
+    {
+      size_t cnt = 0;
+
+      while( all->pa_profiles[cnt] ) ++cnt;
+
+      profile_cache_prof  = calloc(cnt, sizeof *profile_cache_prof);
+      profile_cache_profs = cnt;
+
+      for( size_t i = 0; i < cnt; ++i )
+      {
+        cacheprof_t *prof = &profile_cache_prof[i];
+
+        // values are moved, names are swapped with NULL
+        prof->cp_name = all->pa_profiles[i], all->pa_profiles[i] = 0;
+        prof->cp_vals = all->pa_values[i];
+
+        while( prof->cp_vals[prof->cp_count].pv_key ) ++prof->cp_count;
+
+        qsort(prof->cp_vals, prof->cp_count, sizeof *prof->cp_vals,
+              profile_cache_compare_cb);
+
+        prof->cp_typed = calloc(prof->cp_count + 1, sizeof *prof->cp_typed);
+
+        for( size_t k = 0; k < prof->cp_count; ++k )
+        {
+          profile_cache_parse(&prof->cp_typed[k], prof->cp_vals[k].pv_val);
+        }
+      }
+
+      // the values arrays are now owned by the cache
+      free(all->pa_values), all->pa_values = 0;
+
+      profile_cache_active = all->pa_active, all->pa_active = 0;
+      profile_cache_primed = 1;
+
+      log_debug("cached %zd profiles\n", cnt);
+    }
+    profile_free_all(all);
+  }
+
+  return profile_cache_primed == 1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_usable  --  check if reads can be served from cache
+ * ------------------------------------------------------------------------- */
+
+static
+bool
+profile_cache_usable(void)
+{
+  return (profile_cache_on &&
+          profile_tracker_is_connected() &&
+          profile_cache_prime());
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_get_profile  --  get active profile name from cache
+ * ------------------------------------------------------------------------- */
+
+const char *
+profile_cache_get_profile(void)
+{
+  return profile_cache_usable() ? profile_cache_active : 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_get_value  --  get value from cache, NULL if not cached
+ * ------------------------------------------------------------------------- */
+
+const char *
+profile_cache_get_value(const char *profile, const char *key)
+{
+  cacheprof_t  *prof = 0;
+  profileval_t *hit  = 0;
+
+  if( key != 0 && profile_cache_usable() &&
+      (prof = profile_cache_find_profile(profile)) != 0 &&
+      (hit = profile_cache_find_value(prof, key)) != 0 )
+  {
+    // NULL if value is being modified
+    return hit->pv_val;
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_get_typed  --  get typed value from cache, NULL if not cached
+ * ------------------------------------------------------------------------- */
+
+const profiletyped_t *
+profile_cache_get_typed(const char *profile, const char *key)
+{
+  cacheprof_t  *prof = 0;
+  profileval_t *hit  = 0;
+
+  if( key != 0 && profile_cache_usable() &&
+      (prof = profile_cache_find_profile(profile)) != 0 &&
+      (hit = profile_cache_find_value(prof, key)) != 0 &&
+      hit->pv_val != 0 )
+  {
+    return &prof->cp_typed[hit - prof->cp_vals];
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_get_values  --  get copy of profile values from cache
+ * ------------------------------------------------------------------------- */
+
+profileval_t *
+profile_cache_get_values(const char *profile)
+{
+  profileval_t *res  = 0;
+  cacheprof_t  *prof = 0;
+
+  if( !profile_cache_usable() ||
+      (prof = profile_cache_find_profile(profile)) == 0 )
+  {
+    goto cleanup;
+  }
+
+  for( size_t i = 0; i < prof->cp_count; ++i )
+  {
+    if( prof->cp_vals[i].pv_val == 0 )
+    {
+      goto cleanup;
+    }
+  }
+
+  res = calloc(prof->cp_count + 1, sizeof *res);
+
+  for( size_t i = 0; i < prof->cp_count; ++i )
+  {
+    const profileval_t *v = &prof->cp_vals[i];
+    profileval_ctor_ex(&res[i], v->pv_key, v->pv_val, v->pv_type);
+  }
+  profileval_ctor(&res[prof->cp_count]);
+
+  cleanup:
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_resolve  --  profile name to use for cacheable requests
+ *
+ * Empty name is replaced with the cached active profile, so that the
+ * reply is known to be for that profile even if the active profile
+ * changes meanwhile. Returns NULL if the reply can not be cached,
+ * otherwise a string that the caller must free.
+ * ------------------------------------------------------------------------- */
+
+char *
+profile_cache_resolve(const char *profile)
+{
+  if( !profile_cache_usable() )
+  {
+    return 0;
+  }
+
+  if( xstrnull(profile) )
+  {
+    profile = profile_cache_active;
+  }
+
+  return profile ? strdup(profile) : 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_set_active  --  active profile changed
+ * ------------------------------------------------------------------------- */
+
+void
+profile_cache_set_active(const char *profile)
+{
+  if( profile_cache_primed == 1 && profile != 0 )
+  {
+    free(profile_cache_active);
+    profile_cache_active = strdup(profile);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_set_value  --  value changed in profile
+ *
+ * Values fetched from the daemon are passed without type and refresh
+ * only values that are already known.
+ * ------------------------------------------------------------------------- */
+
+void
+profile_cache_set_value(const char *profile, const char *key,
+                        const char *val, const char *type)
+{
+  cacheprof_t  *prof = 0;
+  profileval_t *hit  = 0;
+
+  if( profile_cache_primed != 1 || key == 0 || val == 0 )
+  {
+    goto cleanup;
+  }
+
+  if( (prof = profile_cache_find_profile(profile)) == 0 )
+  {
+    // profile added after priming -> served via dbus
+    goto cleanup;
+  }
+
+  if( (hit = profile_cache_find_value(prof, key)) != 0 )
+  {
+    free(hit->pv_val);
+    hit->pv_val = strdup(val);
+    profile_cache_parse(&prof->cp_typed[hit - prof->cp_vals], val);
+  }
+  else if( type != 0 )
+  {
+    size_t cnt = prof->cp_count;
+    size_t pos = 0;
+
+    while( pos < cnt && strcmp(prof->cp_vals[pos].pv_key, key) < 0 ) ++pos;
+
+    prof->cp_vals = realloc(prof->cp_vals, (cnt + 2) * sizeof *prof->cp_vals);
+    memmove(prof->cp_vals + pos + 1, prof->cp_vals + pos,
+            (cnt + 1 - pos) * sizeof *prof->cp_vals);
+    profileval_ctor_ex(&prof->cp_vals[pos], key, val, type);
+
+    prof->cp_typed = realloc(prof->cp_typed, (cnt + 2) * sizeof *prof->cp_typed);
+    memmove(prof->cp_typed + pos + 1, prof->cp_typed + pos,
+            (cnt - pos) * sizeof *prof->cp_typed);
+    profile_cache_parse(&prof->cp_typed[pos], val);
+
+    prof->cp_count = cnt + 1;
+  }
+
+  cleanup:
+
+  return;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_forget_value  --  mark value that is being modified
+ *
+ * The daemon may normalize or reject the new value, so it is not cached
+ * until it is either read back or the change signal arrives.
+ * ------------------------------------------------------------------------- */
+
+static
+void
+profile_cache_forget_key(cacheprof_t *prof, const char *key)
+{
+  profileval_t *hit = profile_cache_find_value(prof, key);
+
+  if( hit != 0 )
+  {
+    free(hit->pv_val), hit->pv_val = 0;
+  }
+}
+
+void
+profile_cache_forget_value(const char *profile, const char *key)
+{
+  cacheprof_t *prof = 0;
+
+  if( profile_cache_primed != 1 || key == 0 )
+  {
+    // nothing cached
+  }
+  else if( (prof = profile_cache_find_profile(profile)) != 0 )
+  {
+    profile_cache_forget_key(prof, key);
+  }
+  else if( xstrnull(profile) )
+  {
+    // active profile is not known -> could be any of them
+    for( size_t i = 0; i < profile_cache_profs; ++i )
+    {
+      profile_cache_forget_key(&profile_cache_prof[i], key);
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_forget_active  --  active profile is being changed
+ * ------------------------------------------------------------------------- */
+
+void
+profile_cache_forget_active(void)
+{
+  free(profile_cache_active);
+  profile_cache_active = 0;
+}
+
+/* ========================================================================= *
+ * API Functions
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_enable  --  serve reads from local copy of profile data
+ * ------------------------------------------------------------------------- */
+
+void
+profile_cache_enable(void)
+{
+  ENTER
+  profile_cache_on = TRUE;
+  LEAVE
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_cache_disable  --  release cached data and read via dbus
+ * ------------------------------------------------------------------------- */
+
+void
+profile_cache_disable(void)
+{
+  ENTER
+  profile_cache_on = FALSE;
+  profile_cache_flush();
+  LEAVE
+}
@@ -35,6 +35,7 @@
 
 #include "confmon.h"
 #include "database.h"
+#include "unique.h"
 #include "xutil.h"
 #include "logging.h"
 
@@ -45,6 +46,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fnmatch.h>
+#include <time.h>
 
 // TODO: do we need to worry about recovering after whole /etc is lost?
 
@@ -69,6 +72,17 @@ static inline void *lea(void *base, int offs)
   return ((char *)base) + offs;
 }
 
+/* ------------------------------------------------------------------------- *
+ * confmon_now  --  monotonic time stamp in milliseconds
+ * ------------------------------------------------------------------------- */
+
+static gint64 confmon_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 /* ------------------------------------------------------------------------- *
  * unpk  --  inotify masks to human readable strings
  * ------------------------------------------------------------------------- */
@@ -144,11 +158,23 @@ static const char *unpk(unsigned mask)
 
 enum
 {
-  CONFMON_RELOAD_DELAY = 5, /* [seconds] amount of time between the last
-                             * modification to configuration files and
-                             * doing the configuration reload */
+  CONFMON_RELOAD_QUIET = 100,  /* [ms] amount of time that must pass
+                                * without modifications to configuration
+                                * files before the reload is done */
+
+  CONFMON_RELOAD_LIMIT = 2000, /* [ms] maximum amount of time between
+                                * the first modification and the reload,
+                                * even if files are still being written */
+
+  CONFMON_RELOAD_MAX   = 60 * 1000, /* [ms] upper bound for the above
+                                     * when given via environment */
 };
 
+/* Defaults can be overridden via environment, e.g. when provisioning
+ * scripts want the changes visible even sooner */
+#define CONFMON_QUIET_ENV "PROFILED_RELOAD_QUIET_MS"
+#define CONFMON_LIMIT_ENV "PROFILED_RELOAD_LIMIT_MS"
+
 /* ========================================================================= *
  * Module Data
  * ========================================================================= */
@@ -156,9 +182,18 @@ enum
 static char *confmon_parent  = 0;  // "/etc"
 static char *confmon_config  = 0;  // "profiled"
 static guint confmon_timeout = 0;  // delayed reaload g_timeout
+static int   confmon_quiet   = CONFMON_RELOAD_QUIET;
+static int   confmon_limit   = CONFMON_RELOAD_LIMIT;
+static gint64 confmon_first  = 0;  // [ms] first unhandled modification
+static gint64 confmon_last   = 0;  // [ms] latest unhandled modification
+static gint64 confmon_due    = 0;  // [ms] when confmon_timeout triggers
 static int   confmon_inotify = -1; // inotify file descriptor
 static guint confmon_iowatch = 0;  // inotify input callback
 
+static unique_t *confmon_changed = 0; // names of changed config files
+static int       confmon_full    = 0; // changes not tracked per file
+static unique_t *confmon_writing = 0; // files modified but not closed
+
 static int   wd_config = -1;       // watch descriptor for config dir
 static int   wd_parent = -1;       // watch descriptor for parent dir
 
@@ -169,6 +204,45 @@ static int  confmon_restart(void);
  * DELAYED RELOAD
  * ========================================================================= */
 
+/* ------------------------------------------------------------------------- *
+ * confmon_forget_changes  --  clear list of files to reload
+ * ------------------------------------------------------------------------- */
+
+static
+void
+confmon_forget_changes(void)
+{
+  unique_delete(confmon_changed), confmon_changed = 0;
+  confmon_full = 0;
+
+  unique_delete(confmon_writing), confmon_writing = 0;
+  confmon_first = confmon_last = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * confmon_reload_wait  --  milliseconds left before reload should be done
+ *
+ * Reload is done when the files have been quiet for confmon_quiet
+ * and nobody is in the middle of writing one, or at the latest when
+ * confmon_limit has passed since the first modification.
+ * ------------------------------------------------------------------------- */
+
+static
+gint64
+confmon_reload_wait(gint64 now)
+{
+  gint64 due = confmon_first + confmon_limit;
+
+  if( confmon_writing == 0 || confmon_writing->un_count == 0 )
+  {
+    if( due > confmon_last + confmon_quiet )
+    {
+      due = confmon_last + confmon_quiet;
+    }
+  }
+  return (due > now) ? (due - now) : 0;
+}
+
 /* ------------------------------------------------------------------------- *
  * confmon_do_reload  --  g_timeout callback that does the actual reload
  * ------------------------------------------------------------------------- */
@@ -181,8 +255,31 @@ confmon_do_reload(gpointer aptr)
 
   OUTPUT_FUNCTION_NAME
 
+  gint64 now  = confmon_now();
+  gint64 wait = confmon_reload_wait(now);
+
   confmon_timeout = 0;
-  database_reload();
+
+  if( wait > 0 )
+  {
+    // more changes arrived since the timer was armed
+    confmon_due = now + wait;
+    confmon_timeout = g_timeout_add(wait, confmon_do_reload, 0);
+    return FALSE;
+  }
+
+  if( confmon_full || confmon_changed == 0 )
+  {
+    database_reload();
+  }
+  else
+  {
+    size_t count = 0;
+    char **names = unique_final(confmon_changed, &count);
+    database_reload_files((const char * const *)names, count);
+  }
+
+  confmon_forget_changes();
   return FALSE;
 }
 
@@ -201,18 +298,72 @@ confmon_cancel_reload(void)
     confmon_timeout = 0;
   }
 }
+
 /* ------------------------------------------------------------------------- *
  * confmon_request_reload  --  request delayed config reload
+ *
+ * The name of the changed file is remembered so that only the changed
+ * files need to be reloaded; NULL name requests full reload. Files
+ * that get IN_MODIFY are considered to be mid-write until some other
+ * event is seen for them. Files that are not config files are ignored.
  * ------------------------------------------------------------------------- */
 
 static
 void
-confmon_request_reload(void)
+confmon_request_reload(const char *name, unsigned mask)
 {
-  confmon_cancel_reload();
-  OUTPUT_FUNCTION_NAME
-  confmon_timeout = g_timeout_add_seconds(CONFMON_RELOAD_DELAY,
-                                          confmon_do_reload,0);
+  gint64 now = confmon_now();
+
+  if( name == 0 || *name == 0 )
+  {
+    confmon_full = 1;
+  }
+  else if( fnmatch(CONFIG_PATTERN, name, 0) != 0 )
+  {
+    // editor swap files etc must not delay or cause reloads
+    return;
+  }
+  else
+  {
+    if( confmon_changed == 0 )
+    {
+      confmon_changed = unique_create();
+    }
+    unique_add(confmon_changed, name);
+
+    if( mask & IN_MODIFY )
+    {
+      if( confmon_writing == 0 )
+      {
+        confmon_writing = unique_create();
+      }
+      unique_remove(confmon_writing, name);
+      unique_add(confmon_writing, name);
+    }
+    else if( confmon_writing != 0 )
+    {
+      unique_remove(confmon_writing, name);
+    }
+  }
+
+  if( confmon_first == 0 )
+  {
+    confmon_first = now;
+  }
+  confmon_last = now;
+
+  // the timer re-arms itself if the reload gets postponed, it
+  // needs to be restarted only when the reload should happen sooner,
+  // i.e. when the last pending write has been finished
+  gint64 wait = confmon_reload_wait(now);
+
+  if( confmon_timeout == 0 || now + wait < confmon_due )
+  {
+    OUTPUT_FUNCTION_NAME
+    confmon_cancel_reload();
+    confmon_due = now + wait;
+    confmon_timeout = g_timeout_add(wait, confmon_do_reload, 0);
+  }
 }
 
 /* ========================================================================= *
@@ -235,7 +386,6 @@ confmon_inotify_cb(GIOChannel   *source,
 
   int disable = 0;
   int restart = 0;
-  int reload  = 0;
 
   char buf[2<<10];
   struct inotify_event *eve;
@@ -292,7 +442,20 @@ confmon_inotify_cb(GIOChannel   *source,
       }
       else if( eve->wd == wd_config )
       {
-        reload = 1;
+        if( eve->mask & IN_IGNORED )
+        {
+          // config dir removed, everything goes
+          confmon_request_reload(0, 0);
+        }
+        else
+        {
+          confmon_request_reload(eve->len ? eve->name : 0, eve->mask);
+        }
+      }
+      else if( eve->mask & IN_Q_OVERFLOW )
+      {
+        // events were lost, do not know what changed
+        confmon_request_reload(0, 0);
       }
 
       n -= k;
@@ -305,16 +468,9 @@ confmon_inotify_cb(GIOChannel   *source,
     log_warning("config file inotify monitoring disabled\n");
     confmon_disable();
   }
-  else
+  else if( restart )
   {
-    if( reload )
-    {
-      confmon_request_reload();
-    }
-    if( restart )
-    {
-      confmon_restart();
-    }
+    confmon_restart();
   }
 
   return !disable;
@@ -394,7 +550,8 @@ confmon_restart(void)
 
   wd_config = inotify_add_watch(confmon_inotify,
                                 CONFIG_DIR,
-                                IN_CLOSE_WRITE|IN_DELETE);
+                                IN_MODIFY|IN_CLOSE_WRITE|IN_DELETE|
+                                IN_MOVED_FROM|IN_MOVED_TO);
 
   if( wd_config == -1 )
   {
@@ -534,6 +691,51 @@ confmon_quit_paths(void)
   xstrset(&confmon_config, 0);
 }
 
+/* ------------------------------------------------------------------------- *
+ * confmon_getenv_delay  --  get reload delay override from environment
+ * ------------------------------------------------------------------------- */
+
+static
+int
+confmon_getenv_delay(const char *name, int def)
+{
+  const char *str = getenv(name);
+  char       *end = 0;
+  long        val = def;
+
+  if( str != 0 && *str != 0 )
+  {
+    val = strtol(str, &end, 0);
+    if( *end != 0 || val < 0 || val > CONFMON_RELOAD_MAX )
+    {
+      log_warning("%s: invalid delay '%s', using %d ms\n", name, str, def);
+      val = def;
+    }
+  }
+  return (int)val;
+}
+
+/* ------------------------------------------------------------------------- *
+ * confmon_init_delays  --  set up config reload timing
+ * ------------------------------------------------------------------------- */
+
+static
+void
+confmon_init_delays(void)
+{
+  confmon_quiet = confmon_getenv_delay(CONFMON_QUIET_ENV,
+                                       CONFMON_RELOAD_QUIET);
+  confmon_limit = confmon_getenv_delay(CONFMON_LIMIT_ENV,
+                                       CONFMON_RELOAD_LIMIT);
+
+  if( confmon_limit < confmon_quiet )
+  {
+    confmon_limit = confmon_quiet;
+  }
+  log_debug("config reload: quiet %d ms, limit %d ms\n",
+            confmon_quiet, confmon_limit);
+}
+
 /* ========================================================================= *
  * EXTERNAL API
  * ========================================================================= */
@@ -546,6 +748,7 @@ int
 confmon_init(void)
 {
   confmon_init_paths();
+  confmon_init_delays();
   return confmon_start();
 }
 
@@ -557,6 +760,7 @@ void
 confmon_quit(void)
 {
   confmon_cancel_reload();
+  confmon_forget_changes();
   confmon_disable();
   confmon_quit_paths();
 }
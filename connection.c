@@ -34,17 +34,98 @@
 #include "profiled_config.h"
 
 #include "libprofile-internal.h"
+#include "profile_dbus.h"
 #include "logging.h"
+#include "xutil.h"
 
 #include <stdlib.h>
 
 static int             zz_blocked = 0;
 static DBusConnection *zz_conn = 0;
 
+/* Private peer-to-peer connection to profiled, used for method
+ * calls when available. Signals are received via zz_conn. */
+static DBusConnection *zz_direct = 0;
+static int             zz_direct_tried = 0;
+
 /* ========================================================================= *
  * Internal Functions
  * ========================================================================= */
 
+/* ------------------------------------------------------------------------- *
+ * profile_connection_direct_close
+ * ------------------------------------------------------------------------- */
+
+static
+void
+profile_connection_direct_close(void)
+{
+  if( zz_direct != 0 )
+  {
+    ENTER
+    dbus_connection_close(zz_direct);
+    dbus_connection_unref(zz_direct);
+    zz_direct = 0;
+    LEAVE
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_connection_direct_open  --  connect to profiled peer-to-peer
+ * ------------------------------------------------------------------------- */
+
+static
+DBusConnection *
+profile_connection_direct_open(DBusConnection *bus)
+{
+  DBusConnection *con  = 0;
+  DBusMessage    *msg  = 0;
+  DBusMessage    *rsp  = 0;
+  DBusError       err  = DBUS_ERROR_INIT;
+  const char     *addr = 0;
+
+  if( !(msg = dbus_message_new_method_call(PROFILED_SERVICE,
+                                           PROFILED_PATH,
+                                           PROFILED_INTERFACE,
+                                           PROFILED_GET_DIRECT_ADDRESS)) )
+  {
+    goto cleanup;
+  }
+
+  if( !(rsp = dbus_connection_send_with_reply_and_block(bus, msg, -1, &err)) )
+  {
+    // older profiled or not running -> keep using the bus
+    log_debug("%s: %s: %s\n", PROFILED_GET_DIRECT_ADDRESS,
+              err.name, err.message);
+    goto cleanup;
+  }
+
+  if( !dbus_message_get_args(rsp, &err,
+                             DBUS_TYPE_STRING, &addr,
+                             DBUS_TYPE_INVALID) || xstrnull(addr) )
+  {
+    goto cleanup;
+  }
+
+  if( !(con = dbus_connection_open_private(addr, &err)) )
+  {
+    log_warning("%s: %s: %s\n", addr, err.name, err.message);
+    goto cleanup;
+  }
+
+  dbus_connection_set_exit_on_disconnect(con, 0);
+  log_debug("using peer-to-peer connection %s\n", addr);
+
+  cleanup:
+
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  dbus_error_free(&err);
+
+  return con;
+}
+
 /* ------------------------------------------------------------------------- *
  * profile_connection_disconnect
  * ------------------------------------------------------------------------- */
@@ -53,6 +134,9 @@ static
 void
 profile_connection_disconnect(void)
 {
+  profile_connection_direct_close();
+  zz_direct_tried = 0;
+
   if( zz_conn != 0 )
   {
     ENTER
@@ -154,6 +238,44 @@ profile_connection_get(void)
   return conn;
 }
 
+/* ------------------------------------------------------------------------- *
+ * profile_connection_get_direct  --  connection for method calls
+ *
+ * Returns the peer-to-peer connection to profiled if it has one,
+ * otherwise the bus connection. The caller must unref the result.
+ * ------------------------------------------------------------------------- */
+
+DBusConnection *
+profile_connection_get_direct(void)
+{
+  ENTER
+  DBusConnection *conn = profile_connection_get();
+
+  if( conn != 0 )
+  {
+    // profiled restarted -> it might listen on a new address
+    if( zz_direct != 0 && !dbus_connection_get_is_connected(zz_direct) )
+    {
+      profile_connection_direct_close();
+      zz_direct_tried = 0;
+    }
+
+    if( zz_direct == 0 && !zz_direct_tried )
+    {
+      zz_direct_tried = 1;
+      zz_direct = profile_connection_direct_open(conn);
+    }
+
+    if( zz_direct != 0 )
+    {
+      dbus_connection_unref(conn);
+      conn = dbus_connection_ref(zz_direct);
+    }
+  }
+  LEAVE
+  return conn;
+}
+
 /* ------------------------------------------------------------------------- *
  * profile_connection_set
  * ------------------------------------------------------------------------- */
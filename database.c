@@ -36,13 +36,20 @@
 #include "database.h"
 #include "logging.h"
 #include "inifile.h"
+#include "atom.h"
+#include "datatype.h"
+#include "staticdb.h"
+#include "journal.h"
+#include "savesched.h"
 #include "unique.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <glob.h>
+#include <fnmatch.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <glib.h>
 
 /* ========================================================================= *
@@ -50,21 +57,23 @@
  * ========================================================================= */
 
 #define CUSTOM_INI   "custom.ini"
+#define CUSTOM_LOG   "custom.log"
 #define CURRENT_TXT  "current"
+#define STATIC_DB    "static.db"
 
-#define OVERRIDE "override"
-#define FALLBACK "fallback"
-#define DATATYPE "datatype"
+#define GENERAL  "general"
 
 enum
 {
-  RETRY_SAVE_PERIOD = 60, /* seconds between retries, when data
-                           * saving fails (disk full etc) */
-
   MINIMUM_CUSTOM_INI_SIZE = 4<<10, /* the file will be padded to this
                                     * length so that we have some reserve
                                     * space available on filesystem full
                                     * situations */
+
+  JOURNAL_COMPACT_SIZE = 16<<10, /* custom value changes are appended to
+                                  * journal file, which is compacted to
+                                  * custom.ini when it grows past this
+                                  * size; zero disables journaling */
 };
 
 /* ========================================================================= *
@@ -77,10 +86,39 @@ static char *database_previous = 0; // previously this was active
 static inifile_t *database_static  = 0; // loaded from CONFIG_DIR/*.ini
 static inifile_t *database_custom  = 0; // stored at CUSTOM_INI
 
+// per-file layers that database_static is merged from, in priority
+// order; not available when database_static came from a snapshot
+typedef struct
+{
+  char      *ly_name; // file name within CONFIG_DIR
+  inifile_t *ly_ini;
+} dblayer_t;
+
+static dblayer_t *database_layers      = 0;
+static size_t     database_layer_count = 0;
+static int        database_layers_ok   = 0;
+
+// profile and key names derived from database_static, valid until
+// the configuration files are reloaded
+static char  **database_profiles_cache = 0;
+static size_t  database_profiles_count = 0;
+static char  **database_keys_cache     = 0;
+static size_t  database_keys_count     = 0;
+
+// compiled [datatype] specifications, keyed by specification atom
+static symtab_t *database_datatypes = 0;
+
 static char *custom_work = 0; // path to custom values save file
 static char *custom_path = 0;
 static char *custom_back = 0;
 
+static char *static_path = 0; // path to static configuration snapshot
+
+static char      *journal_path     = 0; // path to custom value journal
+static journal_t *database_journal = 0; // changes not yet in journal file
+static size_t     database_journal_size  = 0; // journal file size
+static int        database_journal_stale = 0; // compaction needed
+
 static char *current_work = 0; // path to current profile name save file
 static char *current_path = 0;
 static char *current_back = 0;
@@ -90,10 +128,22 @@ static char *current_back = 0;
 static struct stat database_custom_stat;
 static struct stat database_current_stat;
 
+// size and hash of content last read from or written to the data
+// files; valid as long as the above stats match the files
+typedef struct
+{
+  int      dk_known;
+  size_t   dk_size;
+  uint32_t dk_hash;
+} dbdisk_t;
+
+static dbdisk_t database_custom_disk;
+static dbdisk_t database_current_disk;
+
 // sections that can be modified only via configuration files
 char const* const database_specials[] =
 {
-  OVERRIDE, FALLBACK, DATATYPE, 0
+  OVERRIDE, FALLBACK, DATATYPE, SETTINGS, 0
 };
 
 // names of profiles that will be always available
@@ -107,6 +157,8 @@ char const* const database_builtins[] =
 };
 
 static void database_generate_changes(void);
+static void database_flush_names(void);
+static void database_save_policy(void);
 
 /* ========================================================================= *
  * Module Callbacks
@@ -211,6 +263,25 @@ static const char *datatype_(const char *key)
   return inifile_get(database_static, DATATYPE, key, NULL);
 }
 
+/* ------------------------------------------------------------------------- *
+ * compiled_  --  helper for getting compiled datatype for key
+ * ------------------------------------------------------------------------- */
+
+static const datatype_t *compiled_(const char *key)
+{
+  const char *spec = datatype_(key);
+  datatype_t *type = 0;
+
+  if( spec != 0 && database_datatypes != 0 )
+  {
+    if( !(type = symtab_lookup(database_datatypes, spec)) )
+    {
+      type = symtab_insert(database_datatypes, spec);
+    }
+  }
+  return type;
+}
+
 /* ------------------------------------------------------------------------- *
  * fallback_  --  helper for getting fallback value for key
  * ------------------------------------------------------------------------- */
@@ -253,8 +324,6 @@ static const char *custom_(const char *profile, const char *key)
 
 static const char *current_(const char *profile, const char *key)
 {
-  static const char general[] = "general";
-
   /* - - - - - - - - - - - - - - - - - - - *
    * profile lookup order:
    * 1. config: "override"
@@ -285,14 +354,14 @@ static const char *current_(const char *profile, const char *key)
     goto cleanup;
   }
 
-  if( !xstrsame(profile, general) )
+  if( !xstrsame(profile, GENERAL) )
   {
-    if( !xstrnull(res = custom_(general, key)) )
+    if( !xstrnull(res = custom_(GENERAL, key)) )
     {
       // have non-empty custom value for general profile
       goto cleanup;
     }
-    if( (res = config_(general, key)) )
+    if( (res = config_(GENERAL, key)) )
     {
       // have non-empty default value for general profile
       goto cleanup;
@@ -307,432 +376,1660 @@ cleanup:
   return res;
 }
 
-static const char *datadir(void)
+/* ========================================================================= *
+ * Resolved Value Cache
+ * ========================================================================= */
+
+/* Walking the lookup chain in current_() takes up to six section and
+ * key lookups per value. The results are materialized for all profiles,
+ * so that value queries need just one profile and one key lookup.
+ *
+ * The cached values and types are atoms referenced by the cache. Changes
+ * to custom values are patched in via database_resolved_patch() and
+ * reloading the static configuration must be followed by a call to
+ * database_resolved_refresh().
+ *
+ * Every change to a resolved value stamps the slot with a new
+ * database_generation number. Change broadcasts then just pick the
+ * slots that are newer than the generation of the previous broadcast.
+ * Slots for keys that disappear due to configuration changes are left
+ * with NULL value until the removal has been broadcast.
+ */
+
+typedef struct resval_t  resval_t;
+typedef struct resprof_t resprof_t;
+
+static unsigned database_generation = 0; // last value change stamp
+
+/* ------------------------------------------------------------------------- *
+ * resval_t  --  resolved value for one key
+ * ------------------------------------------------------------------------- */
+
+struct resval_t
 {
-  static gchar *path = NULL;
+  const char *rv_key;   // atom
+  const char *rv_val;   // atom, or NULL if the key has been dropped
+  const char *rv_type;  // atom, or NULL if datatype is not defined
+  unsigned    rv_gen;   // generation of the last value change
+  int         rv_typed; // rv_data is valid
+  datavalue_t rv_data;  // value in typed form
+};
 
-  if( !path )
-  {
-    path = g_strdup_printf("%s/profiled", g_get_user_config_dir() ?: "/tmp");
-  }
-  return path;
+static void *
+resval_create_cb(const char *key)
+{
+  resval_t *self = calloc(1, sizeof *self);
+  self->rv_key  = atom_intern(key);
+  self->rv_val  = 0;
+  self->rv_type = 0;
+  self->rv_gen  = 0;
+  return self;
 }
 
-static const char *legacydir(void)
+static void
+resval_delete_cb(void *self)
 {
-  static char path[256] = "";
-
-  if( *path == 0 )
+  resval_t *rv = self;
+  if( rv != 0 )
   {
-    snprintf(path, sizeof path, "%s/.profiled", getenv("HOME") ?: "/tmp");
+    atom_release(rv->rv_key);
+    atom_release(rv->rv_val);
+    atom_release(rv->rv_type);
+    free(rv);
   }
-  return path;
 }
 
-static int isdir(const char *path)
+static const char *
+resval_getkey_cb(const void *self)
 {
-  struct stat st;
-  return path && !stat(path, &st) && S_ISDIR(st.st_mode);
+  return ((const resval_t *)self)->rv_key;
 }
 
-static int prepdir(char *path)
+/* ------------------------------------------------------------------------- *
+ * resprof_t  --  resolved values for one profile
+ * ------------------------------------------------------------------------- */
+
+struct resprof_t
 {
-  if( !isdir(path) )
-  {
-    char *end = strrchr(path, '/');
-    int   res = -1;
+  const char *rp_name;   // atom
+  unsigned    rp_gen;    // highest rv_gen within rp_values
+  symtab_t    rp_values;
+  void      **rp_sorted; // rp_values in key order, NULL if not made yet
+};
 
-    if( end != 0 && end > path )
-    {
-      *end = 0;
-      res = prepdir(path);
-      *end = '/';
-    }
+static void *
+resprof_create_cb(const char *name)
+{
+  resprof_t *self = calloc(1, sizeof *self);
+  self->rp_name   = atom_intern(name);
+  self->rp_gen    = 0;
+  self->rp_sorted = 0;
+  symtab_ctor_atoms(&self->rp_values,
+                    resval_create_cb,
+                    resval_delete_cb,
+                    resval_getkey_cb);
+  return self;
+}
 
-    if( res == 0 )
-    {
-      if( mkdir(path, 0755) == -1 )
-      {
-        log_err("%s: mkdir: %s\n", path, strerror(errno));
-      }
-      return isdir(path) ? 0 : -1;
-    }
-    return -1;
+static void
+resprof_delete_cb(void *self)
+{
+  resprof_t *rp = self;
+  if( rp != 0 )
+  {
+    free(rp->rp_sorted);
+    symtab_dtor(&rp->rp_values);
+    atom_release(rp->rp_name);
+    free(rp);
   }
-  return 0;
 }
 
-static int prepfile(char *path)
+static const char *
+resprof_getkey_cb(const void *self)
 {
-  char *end = strrchr(path, '/');
-  int   res = 0;
+  return ((const resprof_t *)self)->rp_name;
+}
 
-  if( end != 0 && end > path )
+/* ------------------------------------------------------------------------- *
+ * resprof_insert  --  get value slot for key, add one if needed
+ * ------------------------------------------------------------------------- */
+
+static resval_t *
+resprof_insert(resprof_t *self, const char *key)
+{
+  size_t    cnt = self->rp_values.st_count;
+  resval_t *rv  = symtab_insert(&self->rp_values, key);
+
+  if( self->rp_values.st_count != cnt )
   {
-    *end = 0;
-    res = prepdir(path);
-    *end = '/';
+    free(self->rp_sorted), self->rp_sorted = 0;
   }
-  return res;
+  return rv;
 }
 
 /* ------------------------------------------------------------------------- *
- * database_load_config  --  load static profile data
+ * resprof_remove  --  remove value slot for key
  * ------------------------------------------------------------------------- */
 
 static void
-database_load_config(void)
+resprof_remove(resprof_t *self, const char *key)
 {
-  glob_t globbuf;
+  symtab_remove(&self->rp_values, key);
+  free(self->rp_sorted), self->rp_sorted = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * resprof_sorted  --  value slots in key order
+ *
+ * The array is owned by the profile and is made again only after
+ * the set of keys has changed.
+ * ------------------------------------------------------------------------- */
 
-  glob(CONFIG_DIR"/[0-9][0-9].*.ini", GLOB_MARK, 0, &globbuf);
-  for( size_t i = 0; i < globbuf.gl_pathc; ++i )
+static resval_t * const *
+resprof_sorted(resprof_t *self)
+{
+  if( self->rp_sorted == 0 )
   {
-    inifile_load(database_static, globbuf.gl_pathv[i]);
+    self->rp_sorted = symtab_sorted(&self->rp_values);
   }
-  globfree(&globbuf);
+  return (resval_t * const *)self->rp_sorted;
 }
 
+static symtab_t *database_resolved = 0; // resolved values per profile
+
 /* ------------------------------------------------------------------------- *
- * database_load_custom  --  load custom profile data
+ * database_resolved_stamp  --  mark value as changed
  * ------------------------------------------------------------------------- */
 
 static void
-database_load_custom(void)
+database_resolved_stamp(resprof_t *rp, resval_t *rv)
 {
-  inifile_load(database_custom, custom_path);
+  rv->rv_gen = rp->rp_gen = ++database_generation;
 }
 
 /* ------------------------------------------------------------------------- *
- * database_save_custom  --  save custom profile data
+ * database_resolved_update  --  re-evaluate lookup chain for one value
  * ------------------------------------------------------------------------- */
 
-static int
-database_save_custom_cb(const inisec_t *s, const inival_t *v, void *aptr)
+static void
+database_resolved_update(resprof_t *rp, resval_t *rv)
 {
-  const char *prf = s->is_name;
-  const char *key = v->iv_key;
-  const char *val = v->iv_val;
-  inifile_t  *ini = aptr;
+  const char *typ = atom_ref(datatype_(rv->rv_key));
+  const char *val = 0;
 
-  /* empty value means "use default inheritance" -> do not save them */
-  if( !xstrnull(val) )
+  /* Keys without datatype are visible only as empty values */
+  if( typ != 0 )
   {
-    inifile_set(ini, prf, key, val);
+    val = atom_ref(current_(rp->rp_name, rv->rv_key));
   }
-  return 0;
+  else
+  {
+    val = atom_intern("");
+  }
+
+  /* New slots are treated as if they had empty value */
+  if( val != rv->rv_val && !xstrsame(val, rv->rv_val ?: "") )
+  {
+    database_resolved_stamp(rp, rv);
+  }
+
+  atom_release(rv->rv_val),  rv->rv_val  = val;
+  atom_release(rv->rv_type), rv->rv_type = typ;
+
+  const datatype_t *dt = compiled_(rv->rv_key);
+
+  rv->rv_typed = (dt != 0 && datatype_parse(dt, val, &rv->rv_data) == 0);
 }
 
-static int
-database_save_custom(void)
+/* ------------------------------------------------------------------------- *
+ * database_resolved_drop  --  mark value as removed
+ * ------------------------------------------------------------------------- */
+
+static void
+database_resolved_drop(resprof_t *rp, resval_t *rv)
 {
-  int     error    = -1;
-  char   *old_data = 0;
-  size_t  old_size = 0;
-  char   *new_data = 0;
-  size_t  new_size = 0;
+  if( rv->rv_val != 0 )
+  {
+    atom_release(rv->rv_val),  rv->rv_val  = 0;
+    atom_release(rv->rv_type), rv->rv_type = 0;
+    database_resolved_stamp(rp, rv);
+  }
+}
 
-  // make sure we have data directory
-  if( prepfile(custom_work) == -1 )
+/* ------------------------------------------------------------------------- *
+ * database_resolved_fill  --  add slots for all keys
+ * ------------------------------------------------------------------------- */
+
+static void
+database_resolved_fill(resprof_t *rp, const char * const *key)
+{
+  for( int k = 0; key && key[k]; ++k )
   {
-    goto cleanup;
+    resval_t *rv = resprof_insert(rp, key[k]);
+    database_resolved_update(rp, rv);
   }
+}
 
-  // create new content
-  inifile_t ini;
-  inifile_ctor(&ini);
-  inifile_scan_values(database_custom, database_save_custom_cb, &ini);
-  inifile_save_to_memory(&ini, &new_data, &new_size,
-                         "custom profile values",
-                         MINIMUM_CUSTOM_INI_SIZE);
-  inifile_dtor(&ini);
+/* ------------------------------------------------------------------------- *
+ * database_resolved_profile  --  get resolved values, fill in on demand
+ * ------------------------------------------------------------------------- */
 
-  // load old content
-  xloadfile(custom_path, &old_data, &old_size);
+static resprof_t *
+database_resolved_profile(const char *profile)
+{
+  resprof_t *rp = 0;
 
-  // write to flash only if needed
-  if( old_size != new_size || memcmp(old_data, new_data, new_size) )
+  if( database_resolved == 0 )
   {
-    if( xexists(custom_back) && !xexists(custom_work) )
-    {
-      rename(custom_back, custom_work);
-    }
-    if( xsavefile(custom_work, 0666, new_data, new_size) == -1 )
-    {
-      goto cleanup;
-    }
-    if( xcyclefiles(custom_work, custom_path, custom_back) == -1 )
-    {
-      goto cleanup;
-    }
+    database_resolved = symtab_create_atoms(resprof_create_cb,
+                                            resprof_delete_cb,
+                                            resprof_getkey_cb);
   }
 
-  if( !xexists(custom_back) && !xexists(custom_work) )
+  if( (rp = symtab_lookup(database_resolved, profile)) )
   {
-    xsavefile(custom_back, 0666, new_data, new_size);
+    goto cleanup;
   }
 
-  // success
-  error = 0;
-
-  cleanup:
+  /* Values for non-existing profiles are not cached */
+  if( !database_has_profile(profile) )
+  {
+    goto cleanup;
+  }
 
-  free(old_data);
-  free(new_data);
+  rp = symtab_insert(database_resolved, profile);
 
-  //log_crit_F("error=%d\n", error);
+  database_resolved_fill(rp, database_get_keys(0));
 
-  return error;
+cleanup:
+  return rp;
 }
 
 /* ------------------------------------------------------------------------- *
- * database_save_current  --  store currently active profile to file
+ * database_resolved_patch  --  update cached value after custom changes
  * ------------------------------------------------------------------------- */
 
-static int
-database_save_current(void)
+static void
+database_resolved_patch(const char *profile, const char *key)
 {
-  int     error = -1;
-  char   *old_data = 0;
-  size_t  old_size = 0;
-  char   *new_data = 0;
-  size_t  new_size = 0;
-
-  // make sure we have data directory
-  if( prepfile(current_work) == -1 )
-  {
-    goto cleanup;
-  }
-
-  // create new content
-  if( !(new_data = xstrfmt("%s\n", database_current)) )
+  if( database_resolved == 0 )
   {
     goto cleanup;
   }
-  new_size = strlen(new_data);
 
-  // load old content
-  xloadfile(current_path, &old_data, &old_size);
+  /* Custom values in the general profile are inherited by
+   * all other profiles, otherwise only the profile itself
+   * is affected */
 
-  // write to flash only if needed
-  if( old_size != new_size || memcmp(old_data, new_data, new_size) )
+  if( !xstrsame(profile, GENERAL) )
   {
-    if( xexists(current_back) && !xexists(current_work) )
-    {
-      rename(current_back, current_work);
-    }
-    if( xsavefile(current_work, 0666, new_data, new_size) == -1 )
-    {
-      goto cleanup;
-    }
-    if( xcyclefiles(current_work, current_path, current_back) == -1 )
+    resprof_t *rp = symtab_lookup(database_resolved, profile);
+    resval_t  *rv = rp ? symtab_lookup(&rp->rp_values, key) : 0;
+    if( rv != 0 && rv->rv_val != 0 )
     {
-      goto cleanup;
+      database_resolved_update(rp, rv);
     }
+    goto cleanup;
   }
 
-  if( !xexists(current_back) && !xexists(current_work) )
+  for( size_t i = 0; i < database_resolved->st_count; ++i )
   {
-    xsavefile(current_back, 0666, new_data, new_size);
+    resprof_t *rp = database_resolved->st_elem[i];
+    resval_t  *rv = symtab_lookup(&rp->rp_values, key);
+    if( rv != 0 && rv->rv_val != 0 )
+    {
+      database_resolved_update(rp, rv);
+    }
   }
 
-  // success
-  error = 0;
-
-  cleanup:
-
-  free(old_data);
-  free(new_data);
-
-  //log_crit_F("error=%d\n", error);
-  return error;
+cleanup:
+  return;
 }
 
 /* ------------------------------------------------------------------------- *
- * database_load_current  --  restore currently active profile from file
+ * database_resolved_refresh  --  re-evaluate all values after reload
  * ------------------------------------------------------------------------- */
 
 static void
-database_load_current(void)
+database_resolved_refresh(void)
 {
-  char   *old_data = 0;
-  size_t  old_size = 0;
+  const char * const *prof = database_get_profiles(0);
+  const char * const *key  = database_get_keys(0);
 
-  if( xloadfile(current_path, &old_data, &old_size) == 0 )
+  /* Drop values for profiles and keys that no longer exist */
+  if( database_resolved != 0 )
   {
-    old_data[strcspn(old_data,"\r\n")] = 0;
-    xstripall(old_data);
+    for( size_t i = 0; i < database_resolved->st_count; ++i )
+    {
+      resprof_t *rp   = database_resolved->st_elem[i];
+      int        live = database_has_profile(rp->rp_name);
+
+      for( size_t k = 0; k < rp->rp_values.st_count; ++k )
+      {
+        resval_t *rv = rp->rp_values.st_elem[k];
+
+        if( !live || fallback_(rv->rv_key) == 0 )
+        {
+          database_resolved_drop(rp, rv);
+        }
+      }
+    }
   }
 
-  if( xisempty(old_data) || database_set_profile(old_data) == -1 )
+  /* Update existing and add new values */
+  for( int p = 0; prof && prof[p]; ++p )
   {
-    xstrset(&database_current, *database_builtins);
+    resprof_t *rp = database_resolved_profile(prof[p]);
+    database_resolved_fill(rp, key);
   }
-
-  free(old_data);
 }
 
 /* ------------------------------------------------------------------------- *
- * database_load  --  load all profile data
+ * database_resolved_rekey  --  re-evaluate given keys after partial reload
  * ------------------------------------------------------------------------- */
 
 static void
-database_load(void)
+database_resolved_rekey(const char * const *key)
 {
-  database_load_config();
-  database_load_custom();
-  database_load_current();
+  if( database_resolved != 0 )
+  {
+    for( size_t i = 0; i < database_resolved->st_count; ++i )
+    {
+      resprof_t *rp = database_resolved->st_elem[i];
 
-  xfetchstats(custom_path, &database_custom_stat);
-  xfetchstats(current_path, &database_current_stat);
+      /* Profile itself is gone -> drop all of its values */
+      if( !database_has_profile(rp->rp_name) )
+      {
+        for( size_t k = 0; k < rp->rp_values.st_count; ++k )
+        {
+          database_resolved_drop(rp, rp->rp_values.st_elem[k]);
+        }
+        continue;
+      }
+
+      for( int k = 0; key && key[k]; ++k )
+      {
+        if( fallback_(key[k]) != 0 )
+        {
+          database_resolved_update(rp, resprof_insert(rp, key[k]));
+        }
+        else
+        {
+          resval_t *rv = symtab_lookup(&rp->rp_values, key[k]);
+          if( rv != 0 ) database_resolved_drop(rp, rv);
+        }
+      }
+    }
+  }
+
+  /* Profiles that did not exist before get filled in on demand */
+  const char * const *prof = database_get_profiles(0);
+
+  for( int p = 0; prof && prof[p]; ++p )
+  {
+    database_resolved_profile(prof[p]);
+  }
 }
 
 /* ------------------------------------------------------------------------- *
- * database_reload  --  reload configurarion files & broadcast changes
+ * database_resolved_purge  --  remove slots of dropped values
  * ------------------------------------------------------------------------- */
 
-void
-database_reload(void)
+static void
+database_resolved_purge(void)
 {
-  // reload config files
+  if( database_resolved == 0 )
+  {
+    goto cleanup;
+  }
 
-  inifile_delete(database_static);
-  database_static  = inifile_create();
+  /* Removal moves the last element to the freed position,
+   * so iterating backwards visits every element once */
+
+  for( size_t i = database_resolved->st_count; i-- > 0; )
+  {
+    resprof_t *rp = database_resolved->st_elem[i];
+
+    for( size_t k = rp->rp_values.st_count; k-- > 0; )
+    {
+      resval_t *rv = rp->rp_values.st_elem[k];
+
+      if( rv->rv_val == 0 )
+      {
+        resprof_remove(rp, rv->rv_key);
+      }
+    }
+
+    if( !database_has_profile(rp->rp_name) )
+    {
+      symtab_remove(database_resolved, rp->rp_name);
+    }
+  }
+
+cleanup:
+  return;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_resolved_flush  --  drop all cached values
+ * ------------------------------------------------------------------------- */
+
+static void
+database_resolved_flush(void)
+{
+  symtab_delete(database_resolved), database_resolved = 0;
+}
+
+static const char *datadir(void)
+{
+  static gchar *path = NULL;
+
+  if( !path )
+  {
+    path = g_strdup_printf("%s/profiled", g_get_user_config_dir() ?: "/tmp");
+  }
+  return path;
+}
+
+static const char *cachedir(void)
+{
+  static gchar *path = NULL;
+
+  if( !path )
+  {
+    path = g_strdup_printf("%s/profiled", g_get_user_cache_dir() ?: "/tmp");
+  }
+  return path;
+}
+
+static const char *legacydir(void)
+{
+  static char path[256] = "";
+
+  if( *path == 0 )
+  {
+    snprintf(path, sizeof path, "%s/.profiled", getenv("HOME") ?: "/tmp");
+  }
+  return path;
+}
+
+static int isdir(const char *path)
+{
+  struct stat st;
+  return path && !stat(path, &st) && S_ISDIR(st.st_mode);
+}
+
+static int prepdir(char *path)
+{
+  if( !isdir(path) )
+  {
+    char *end = strrchr(path, '/');
+    int   res = -1;
+
+    if( end != 0 && end > path )
+    {
+      *end = 0;
+      res = prepdir(path);
+      *end = '/';
+    }
+
+    if( res == 0 )
+    {
+      if( mkdir(path, 0755) == -1 )
+      {
+        log_err("%s: mkdir: %s\n", path, strerror(errno));
+      }
+      return isdir(path) ? 0 : -1;
+    }
+    return -1;
+  }
+  return 0;
+}
+
+static int prepfile(char *path)
+{
+  char *end = strrchr(path, '/');
+  int   res = 0;
+
+  if( end != 0 && end > path )
+  {
+    *end = 0;
+    res = prepdir(path);
+    *end = '/';
+  }
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_compile_datatypes  --  parse [datatype] specifications
+ * ------------------------------------------------------------------------- */
+
+static void
+database_compile_datatypes(void)
+{
+  symtab_delete(database_datatypes);
+  database_datatypes = symtab_create_atoms(datatype_create_cb,
+                                           datatype_delete_cb,
+                                           datatype_getkey_cb);
+
+  inisec_t *sec = inifile_get_section(database_static, DATATYPE);
+
+  for( size_t i = 0; sec && i < sec->is_values.st_count; ++i )
+  {
+    inival_t *val = sec->is_values.st_elem[i];
+    symtab_insert(database_datatypes, val->iv_val);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_layers_flush  --  drop per-file configuration layers
+ * ------------------------------------------------------------------------- */
+
+static void
+database_layers_flush(void)
+{
+  for( size_t i = 0; i < database_layer_count; ++i )
+  {
+    free(database_layers[i].ly_name);
+    inifile_delete(database_layers[i].ly_ini);
+  }
+  free(database_layers), database_layers = 0;
+
+  database_layer_count = 0;
+  database_layers_ok   = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_layers_attach  --  add layer, keeping file name order
+ * ------------------------------------------------------------------------- */
+
+static void
+database_layers_attach(const char *name, inifile_t *ini)
+{
+  size_t i = database_layer_count;
+
+  database_layers = realloc(database_layers,
+                            (database_layer_count + 1) *
+                            sizeof *database_layers);
+
+  for( ; i > 0 && strcmp(database_layers[i-1].ly_name, name) > 0; --i )
+  {
+    database_layers[i] = database_layers[i-1];
+  }
+
+  database_layers[i].ly_name = strdup(name);
+  database_layers[i].ly_ini  = ini;
+  database_layer_count += 1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_layers_detach  --  remove layer, returns its content
+ * ------------------------------------------------------------------------- */
+
+static inifile_t *
+database_layers_detach(const char *name)
+{
+  inifile_t *res = 0;
+
+  for( size_t i = 0; i < database_layer_count; ++i )
+  {
+    if( !strcmp(database_layers[i].ly_name, name) )
+    {
+      res = database_layers[i].ly_ini;
+      free(database_layers[i].ly_name);
+
+      database_layer_count -= 1;
+      memmove(&database_layers[i], &database_layers[i+1],
+              (database_layer_count - i) * sizeof *database_layers);
+      break;
+    }
+  }
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_layers_parse  --  load one config file as layer
+ * ------------------------------------------------------------------------- */
+
+static inifile_t *
+database_layers_parse(const char *path)
+{
+  inifile_t *ini = inifile_create_arena();
+
+  if( inifile_load(ini, path) == -1 )
+  {
+    inifile_delete(ini), ini = 0;
+  }
+  return ini;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_layers_merge  --  update one merged value from layers
+ * ------------------------------------------------------------------------- */
+
+static void
+database_layers_merge(const char *sec, const char *key)
+{
+  /* the last layer that has a value wins */
+  for( size_t i = database_layer_count; i-- > 0; )
+  {
+    const char *val = inifile_get(database_layers[i].ly_ini, sec, key, 0);
+    if( val != 0 )
+    {
+      inifile_set(database_static, sec, key, val);
+      return;
+    }
+  }
+  inifile_del(database_static, sec, key);
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_layers_apply  --  merge everything the layer touches
+ * ------------------------------------------------------------------------- */
+
+static void
+database_layers_apply(const inifile_t *layer, unique_t *keys)
+{
+  for( size_t i = 0; layer && i < layer->if_sections.st_count; ++i )
+  {
+    const inisec_t *sec = layer->if_sections.st_elem[i];
+    int             has = 0;
+
+    /* section exists as long as some layer has it, even if empty */
+    for( size_t k = 0; k < database_layer_count && !has; ++k )
+    {
+      has = inifile_has_section(database_layers[k].ly_ini, sec->is_name);
+    }
+
+    if( has )
+    {
+      inifile_add_section(database_static, sec->is_name);
+    }
+    else
+    {
+      inifile_del_section(database_static, sec->is_name);
+    }
+
+    for( size_t k = 0; k < sec->is_values.st_count; ++k )
+    {
+      const inival_t *val = sec->is_values.st_elem[k];
+
+      if( has )
+      {
+        database_layers_merge(sec->is_name, val->iv_key);
+      }
+      unique_add(keys, val->iv_key);
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_load_config  --  load static profile data
+ * ------------------------------------------------------------------------- */
+
+static void
+database_load_config(void)
+{
+  glob_t      globbuf;
+  staticdb_t *packaged = 0;
+  staticdb_t *snapshot = 0;
+
+  database_layers_flush();
+
+  glob(CONFIG_GLOB, GLOB_MARK, 0, &globbuf);
+
+  /* Use the snapshot made by profiled-compile at install time,
+   * or the one made on previous start up, if none of the config
+   * files have changed since. Otherwise parse the files and
+   * refresh the per-user snapshot for the next time */
+
+  packaged = staticdb_create(CONFIG_SNAPSHOT,
+                             globbuf.gl_pathv, globbuf.gl_pathc);
+  snapshot = staticdb_create(static_path,
+                             globbuf.gl_pathv, globbuf.gl_pathc);
+
+  if( staticdb_load(packaged, database_static) == -1 &&
+      staticdb_load(snapshot, database_static) == -1 )
+  {
+    /* Keep the parsed files as layers, so that changes to
+     * individual files can be merged in without reparsing
+     * everything, see database_reload_files() */
+
+    for( size_t i = 0; i < globbuf.gl_pathc; ++i )
+    {
+      const char *path = globbuf.gl_pathv[i];
+      inifile_t  *ini  = database_layers_parse(path);
+
+      if( ini != 0 )
+      {
+        inifile_merge(database_static, ini);
+        database_layers_attach(strrchr(path, '/') + 1, ini);
+      }
+    }
+    inifile_reindex(database_static);
+    database_layers_ok = 1;
+
+    if( snapshot != 0 && prepfile(static_path) == 0 )
+    {
+      staticdb_save(snapshot, database_static);
+    }
+  }
+
+  staticdb_delete(packaged);
+  staticdb_delete(snapshot);
+  globfree(&globbuf);
+
+  database_compile_datatypes();
+  database_save_policy();
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_load_custom  --  load custom profile data
+ * ------------------------------------------------------------------------- */
+
+static void
+database_load_custom(void)
+{
+  char   *data = 0;
+  size_t  size = 0;
+
+  // missing file is the same as empty one, but content is not known
+  database_custom_disk.dk_known = 0;
+  database_custom_disk.dk_size  = 0;
+  database_custom_disk.dk_hash  = xhash(0, 0);
+
+  if( xloadfile(custom_path, &data, &size) == 0 )
+  {
+    // remember what is on disk, journal and saves use it
+    database_custom_disk.dk_known = 1;
+    database_custom_disk.dk_size  = size;
+    database_custom_disk.dk_hash  = xhash(data, size);
+
+    inifile_parse_bulk(database_custom, data, size);
+    inifile_reindex(database_custom);
+  }
+
+  free(data);
+
+  // apply changes saved after custom file was last written
+  if( database_journal != 0 )
+  {
+    journal_replay(journal_path,
+                   database_custom_disk.dk_size,
+                   database_custom_disk.dk_hash,
+                   database_custom, &database_journal_size);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbfile_t  --  content to be written to one data file
+ * ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  char        *df_work;  // temporary file
+  char        *df_path;  // data file
+  char        *df_back;  // backup file
+  char        *df_data;  // new content
+  size_t       df_size;
+  uint32_t     df_hash;  // hash of new content
+  dbdisk_t     df_disk;  // data file content known before/after saving
+  struct stat  df_stat;  // data file stats after saving
+  xcommit_t    df_commit;
+} dbfile_t;
+
+/* ------------------------------------------------------------------------- *
+ * dbsave_t  --  immutable snapshot of data to be saved
+ *
+ * Jobs are created in the main thread and written either directly or
+ * by the saver thread. Inifile content uses atoms that are not thread
+ * safe, so the snapshot is made of serialized file content and copies
+ * of the file paths.
+ *
+ * In journaling mode the custom values are normally saved by appending
+ * the changes to the journal file, the whole custom file is written
+ * only when the journal needs to be compacted.
+ * ------------------------------------------------------------------------- */
+
+enum { DBSAVE_CUSTOM, DBSAVE_CURRENT, DBSAVE_FILES };
+
+typedef struct
+{
+  dbfile_t sv_file[DBSAVE_FILES];
+
+  char    *sv_log_path;  // journal file
+  char    *sv_log_data;  // records to append to journal
+  size_t   sv_log_size;
+  size_t   sv_log_end;   // journal size after writing
+  int      sv_compact;   // write custom file and remove journal
+
+  int      sv_error;
+} dbsave_t;
+
+/* ------------------------------------------------------------------------- *
+ * dbfile_ctor  --  set up data file paths and content
+ * ------------------------------------------------------------------------- */
+
+static void
+dbfile_ctor(dbfile_t *self, const char *work, const char *path,
+            const char *back, char *data, size_t size, const dbdisk_t *disk)
+{
+  self->df_work = strdup(work);
+  self->df_path = strdup(path);
+  self->df_back = strdup(back);
+  self->df_data = data;
+  self->df_size = size;
+  self->df_hash = 0;
+  self->df_disk = *disk;
+  memset(&self->df_stat, 0, sizeof self->df_stat);
+
+  self->df_commit.xc_path  = self->df_path;
+  self->df_commit.xc_work  = self->df_work;
+  self->df_commit.xc_back  = self->df_back;
+  self->df_commit.xc_ready = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbfile_dtor
+ * ------------------------------------------------------------------------- */
+
+static void
+dbfile_dtor(dbfile_t *self)
+{
+  free(self->df_work);
+  free(self->df_path);
+  free(self->df_back);
+  free(self->df_data);
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbfile_unchanged  --  check if data file already has the new content
+ *
+ * Called from the saver thread, must not touch module data.
+ * ------------------------------------------------------------------------- */
+
+static int
+dbfile_unchanged(const dbfile_t *self, uint32_t hash)
+{
+  int     res      = 0;
+  char   *old_data = 0;
+  size_t  old_size = 0;
+
+  if( self->df_disk.dk_known )
+  {
+    // database_save_check() has verified that nobody else has
+    // touched the file since the content was recorded
+    res = (self->df_disk.dk_size == self->df_size &&
+           self->df_disk.dk_hash == hash);
+  }
+  else if( xloadfile(self->df_path, &old_data, &old_size) == 0 )
+  {
+    res = (old_size == self->df_size &&
+           !memcmp(old_data, self->df_data, self->df_size));
+  }
+
+  free(old_data);
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbfile_known  --  make sure data file content on disk is known
+ *
+ * Normally the content is known since loading or the last save, the
+ * file is read only if an earlier save failed or it was missing.
+ *
+ * Called from the saver thread, must not touch module data.
+ * ------------------------------------------------------------------------- */
+
+static void
+dbfile_known(dbfile_t *self)
+{
+  char   *old_data = 0;
+  size_t  old_size = 0;
+
+  if( !self->df_disk.dk_known )
+  {
+    // missing file is treated as empty one
+    xloadfile(self->df_path, &old_data, &old_size);
+
+    self->df_disk.dk_known = (old_data != 0);
+    self->df_disk.dk_size  = old_size;
+    self->df_disk.dk_hash  = xhash(old_data, old_size);
+  }
+
+  free(old_data);
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbfile_stage  --  write new content to temporary file if it has changed
+ *
+ * Called from the saver thread, must not touch module data.
+ * ------------------------------------------------------------------------- */
+
+static int
+dbfile_stage(dbfile_t *self)
+{
+  int error = -1;
+
+  self->df_hash = xhash(self->df_data, self->df_size);
+
+  // make sure we have data directory
+  if( prepfile(self->df_work) == -1 )
+  {
+    goto cleanup;
+  }
+
+  // write to flash only if needed
+  if( !dbfile_unchanged(self, self->df_hash) &&
+      xstagefile(&self->df_commit, 0666,
+                 self->df_data, self->df_size) == -1 )
+  {
+    goto cleanup;
+  }
+
+  // success
+  error = 0;
+
+  cleanup:
+
+  //log_crit_F("error=%d\n", error);
+  return error;
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbfile_done  --  record data file state after the commit
+ *
+ * Called from the saver thread, must not touch module data.
+ * ------------------------------------------------------------------------- */
+
+static void
+dbfile_done(dbfile_t *self, int error)
+{
+  if( error == 0 && !xexists(self->df_back) && !xexists(self->df_work) )
+  {
+    xsavefile(self->df_back, 0666, self->df_data, self->df_size);
+  }
+
+  self->df_disk.dk_known = (error == 0);
+  self->df_disk.dk_size  = self->df_size;
+  self->df_disk.dk_hash  = self->df_hash;
+
+  xfetchstats(self->df_path, &self->df_stat);
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbsave_create  --  take snapshot of custom values and current profile
+ * ------------------------------------------------------------------------- */
+
+static int
+dbsave_custom_cb(const inisec_t *s, const inival_t *v, void *aptr)
+{
+  const char *prf = s->is_name;
+  const char *key = v->iv_key;
+  const char *val = v->iv_val;
+  inifile_t  *ini = aptr;
+
+  /* empty value means "use default inheritance" -> do not save them */
+  if( !xstrnull(val) )
+  {
+    inifile_set(ini, prf, key, val);
+  }
+  return 0;
+}
+
+static dbsave_t *
+dbsave_create(void)
+{
+  dbsave_t *self = calloc(1, sizeof *self);
+  char     *data = 0;
+  size_t    size = 0;
+
+  // journaled changes
+  if( database_journal != 0 )
+  {
+    self->sv_log_path = strdup(journal_path);
+    self->sv_log_data = journal_steal(database_journal, &self->sv_log_size);
+    self->sv_log_end  = database_journal_size;
+
+    self->sv_compact = (database_journal_stale ||
+                        database_journal_size + self->sv_log_size >
+                        JOURNAL_COMPACT_SIZE);
+  }
+  else
+  {
+    self->sv_compact = 1;
+  }
+
+  // custom values
+  if( self->sv_compact )
+  {
+    inifile_t ini;
+    inifile_ctor_arena(&ini);
+    inifile_scan_values(database_custom, dbsave_custom_cb, &ini);
+    inifile_save_to_memory(&ini, &data, &size,
+                           "custom profile values",
+                           MINIMUM_CUSTOM_INI_SIZE);
+    inifile_dtor(&ini);
+  }
+
+  dbfile_ctor(&self->sv_file[DBSAVE_CUSTOM],
+              custom_work, custom_path, custom_back, data, size,
+              &database_custom_disk);
+
+  // current profile
+  data = xstrfmt("%s\n", database_current);
+  size = data ? strlen(data) : 0;
+
+  dbfile_ctor(&self->sv_file[DBSAVE_CURRENT],
+              current_work, current_path, current_back, data, size,
+              &database_current_disk);
+
+  self->sv_error = 0;
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbsave_delete
+ * ------------------------------------------------------------------------- */
+
+static void
+dbsave_delete(dbsave_t *self)
+{
+  if( self != 0 )
+  {
+    for( int i = 0; i < DBSAVE_FILES; ++i )
+    {
+      dbfile_dtor(&self->sv_file[i]);
+    }
+    free(self->sv_log_path);
+    free(self->sv_log_data);
+    free(self);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbsave_write  --  write all files in the snapshot
+ *
+ * Called from the saver thread, must not touch module data.
+ * ------------------------------------------------------------------------- */
+
+static void
+dbsave_write(dbsave_t *self)
+{
+  dbfile_t  *custom = &self->sv_file[DBSAVE_CUSTOM];
+  xcommit_t *commit[DBSAVE_FILES];
+  int        error[DBSAVE_FILES];
+  size_t     count  = 0;
+
+  self->sv_error = 0;
+
+  if( !self->sv_compact )
+  {
+    // group commit: one append and one sync for all changes
+    if( self->sv_log_size != 0 )
+    {
+      dbfile_known(custom);
+
+      if( prepfile(self->sv_log_path) == -1 ||
+          journal_append(self->sv_log_path,
+                         custom->df_disk.dk_size, custom->df_disk.dk_hash,
+                         self->sv_log_data, self->sv_log_size,
+                         &self->sv_log_end) == -1 )
+      {
+        self->sv_error = -1;
+      }
+    }
+    xfetchstats(custom->df_path, &custom->df_stat);
+  }
+
+  // write changed files under temporary names
+  for( int i = 0; i < DBSAVE_FILES; ++i )
+  {
+    dbfile_t *file = &self->sv_file[i];
+
+    error[i] = 0;
+
+    if( i == DBSAVE_CUSTOM && !self->sv_compact )
+    {
+      continue;
+    }
+
+    if( file->df_data == 0 || dbfile_stage(file) == -1 )
+    {
+      error[i] = -1;
+    }
+    else if( file->df_commit.xc_ready )
+    {
+      commit[count++] = &file->df_commit;
+    }
+  }
+
+  // rename them all in place, one directory sync for all files
+  if( xcommitfiles(commit, count) == -1 )
+  {
+    for( int i = 0; i < DBSAVE_FILES; ++i )
+    {
+      error[i] = -1;
+    }
+  }
+
+  for( int i = 0; i < DBSAVE_FILES; ++i )
+  {
+    if( i == DBSAVE_CUSTOM && !self->sv_compact )
+    {
+      continue;
+    }
+
+    dbfile_done(&self->sv_file[i], error[i]);
+
+    if( error[i] != 0 )
+    {
+      self->sv_error = -1;
+    }
+  }
+
+  // the custom file has all the changes -> journal is not needed
+  if( self->sv_compact && error[DBSAVE_CUSTOM] == 0 &&
+      self->sv_log_path != 0 )
+  {
+    if( remove(self->sv_log_path) == -1 && errno != ENOENT )
+    {
+      log_err("%s: remove: %s\n", self->sv_log_path, strerror(errno));
+      self->sv_error = -1;
+    }
+    else
+    {
+      self->sv_log_end = 0;
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * dbsave_finish  --  update module state after the snapshot is written
+ * ------------------------------------------------------------------------- */
+
+static int
+dbsave_finish(dbsave_t *self)
+{
+  database_custom_stat  = self->sv_file[DBSAVE_CUSTOM].df_stat;
+  database_current_stat = self->sv_file[DBSAVE_CURRENT].df_stat;
+
+  database_custom_disk  = self->sv_file[DBSAVE_CUSTOM].df_disk;
+  database_current_disk = self->sv_file[DBSAVE_CURRENT].df_disk;
+
+  if( self->sv_log_path != 0 )
+  {
+    database_journal_size = self->sv_log_end;
+
+    // changes taken from the journal buffer might not have made it
+    // to disk -> the next save must write everything to custom file
+    database_journal_stale = (self->sv_error != 0);
+  }
+  return self->sv_error;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_load_current  --  restore currently active profile from file
+ * ------------------------------------------------------------------------- */
+
+static void
+database_load_current(void)
+{
+  char   *old_data = 0;
+  size_t  old_size = 0;
+
+  if( xloadfile(current_path, &old_data, &old_size) == 0 )
+  {
+    // remember what is on disk, saves can then skip reading it
+    database_current_disk.dk_known = 1;
+    database_current_disk.dk_size  = old_size;
+    database_current_disk.dk_hash  = xhash(old_data, old_size);
+
+    old_data[strcspn(old_data,"\r\n")] = 0;
+    xstripall(old_data);
+  }
+
+  if( xisempty(old_data) || database_set_profile(old_data) == -1 )
+  {
+    xstrset(&database_current, *database_builtins);
+  }
+
+  free(old_data);
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_load  --  load all profile data
+ * ------------------------------------------------------------------------- */
+
+static void
+database_load(void)
+{
   database_load_config();
+  database_load_custom();
+  database_load_current();
+
+  xfetchstats(custom_path, &database_custom_stat);
+  xfetchstats(current_path, &database_current_stat);
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_reload  --  reload configurarion files & broadcast changes
+ * ------------------------------------------------------------------------- */
+
+void
+database_reload(void)
+{
+  // reload config files
+
+  inifile_delete(database_static);
+  database_static  = inifile_create();
+  database_load_config();
+  database_flush_names();
+
+  if( !database_has_profile(database_current) )
+  {
+    // switch back to default profile if the
+    // configuration updates happened to get
+    // rid of the currently active profile
+    xstrset(&database_current, *database_builtins);
+  }
+
+  // re-evaluate values of all profiles
+  database_resolved_refresh();
+
+  // send change notification if needed
+  database_notify_changes();
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_reload_files  --  reload changed config files & broadcast changes
+ *
+ * Only the given files are reparsed, and only the keys they had or
+ * now have are re-resolved.
+ * ------------------------------------------------------------------------- */
+
+void
+database_reload_files(const char * const *names, int count)
+{
+  unique_t keys;
+  int      changed = 0;
+
+  /* Started from snapshot -> no layers to patch yet, do a full
+   * reload that also sets up the layers for the next time */
+  if( !database_layers_ok )
+  {
+    database_reload();
+    return;
+  }
+
+  unique_ctor(&keys);
+
+  for( int i = 0; i < count; ++i )
+  {
+    const char *name = names[i];
+
+    if( fnmatch(CONFIG_PATTERN, name, 0) != 0 )
+    {
+      // not a config file, e.g. the profiled-compile snapshot
+      continue;
+    }
+
+    char      *path = xstrfmt("%s/%s", CONFIG_DIR, name);
+    inifile_t *prev = database_layers_detach(name);
+    inifile_t *next = database_layers_parse(path);
+
+    if( next != 0 )
+    {
+      database_layers_attach(name, next);
+    }
+
+    /* everything the old content had must be merged too,
+     * so that removed values fall back to lower layers */
+    database_layers_apply(prev, &keys);
+    database_layers_apply(next, &keys);
+
+    inifile_delete(prev);
+    free(path);
+
+    changed = 1;
+  }
+
+  if( !changed )
+  {
+    goto cleanup;
+  }
+
+  database_flush_names();
+  database_compile_datatypes();
+  database_save_policy();
+
+  if( !database_has_profile(database_current) )
+  {
+    // see database_reload()
+    xstrset(&database_current, *database_builtins);
+  }
+
+  database_resolved_rekey((const char * const *)unique_final(&keys, 0));
+
+  database_notify_changes();
+
+cleanup:
+
+  unique_dtor(&keys);
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_save_check  --  check that nobody else has touched data files
+ * ------------------------------------------------------------------------- */
+
+static int
+database_save_check(void)
+{
+  static int disabled = 0;
+
+  if( disabled )
+  {
+    log_warning("%s: saving disabled, ignoring save request\n", custom_path);
+  }
+  else
+  {
+    if( !xcheckstats(custom_path,  &database_custom_stat) )
+    {
+      log_warning("%s: modified - disabling saving\n", custom_path);
+      disabled = 1;
+    }
+
+    if( !xcheckstats(current_path, &database_current_stat) )
+    {
+      log_warning("%s: modified - disabling saving\n", current_path);
+      disabled = 1;
+    }
+
+    if( disabled )
+    {
+      database_restart_request();
+    }
+  }
+
+  return disabled ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_save_now  --  save all profile data synchronously
+ * ------------------------------------------------------------------------- */
+
+static int
+database_save_now(void)
+{
+  int error = 0;
+
+  if( database_save_check() == 0 )
+  {
+    dbsave_t *job = dbsave_create();
+    dbsave_write(job);
+    error = dbsave_finish(job);
+    dbsave_delete(job);
+  }
+
+  //log_crit_F("error=%d\n", error);
+  return error;
+}
+
+/* ========================================================================= *
+ * SAVER THREAD
+ *
+ * Writing and fsyncing the data files is done in a dedicated thread
+ * so that slow flash does not stall D-Bus request handling. At most
+ * one snapshot is being written at any time; save requests made
+ * meanwhile are coalesced into one new snapshot that is taken when
+ * the previous one has been completed.
+ * ========================================================================= */
+
+static GThread     *database_saver_thread = 0; // worker thread
+static GAsyncQueue *database_saver_todo   = 0; // main -> worker
+static GAsyncQueue *database_saver_done   = 0; // worker -> main
+static int          database_saver_busy   = 0; // snapshot being written
+static int          database_saver_again  = 0; // save requested meanwhile
+static dbsave_t     database_saver_stop;       // terminates worker
+
+static gboolean database_saver_done_cb(gpointer aptr);
+static void     database_saver_submit(void);
+
+/* ------------------------------------------------------------------------- *
+ * database_saver_main  --  saver thread entry point
+ * ------------------------------------------------------------------------- */
+
+static gpointer
+database_saver_main(gpointer aptr)
+{
+  (void)aptr;
+
+  for( ;; )
+  {
+    dbsave_t *job = g_async_queue_pop(database_saver_todo);
+
+    if( job == &database_saver_stop )
+    {
+      break;
+    }
+
+    dbsave_write(job);
+    g_async_queue_push(database_saver_done, job);
+    g_idle_add(database_saver_done_cb, &database_saver_done);
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_saver_finish  --  handle written snapshots in main thread
+ * ------------------------------------------------------------------------- */
+
+static void
+database_saver_finish(dbsave_t *job)
+{
+  int error = dbsave_finish(job);
+
+  dbsave_delete(job);
+  database_saver_busy = 0;
+
+  savesched_finished(error);
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_saver_done_cb  --  idle callback for completed snapshots
+ * ------------------------------------------------------------------------- */
+
+static gboolean
+database_saver_done_cb(gpointer aptr)
+{
+  (void)aptr;
+
+  dbsave_t *job;
+
+  while( (job = g_async_queue_try_pop(database_saver_done)) != 0 )
+  {
+    database_saver_finish(job);
+  }
+
+  if( database_saver_again && !database_saver_busy )
+  {
+    database_saver_again = 0;
+    database_saver_submit();
+  }
+  return FALSE;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_saver_submit  --  pass snapshot to saver thread
+ * ------------------------------------------------------------------------- */
+
+static void
+database_saver_submit(void)
+{
+  if( database_saver_busy )
+  {
+    // stats are valid only after the previous save has finished
+    database_saver_again = 1;
+  }
+  else if( database_save_check() == 0 )
+  {
+    dbsave_t *job = dbsave_create();
+
+    if( database_saver_thread != 0 )
+    {
+      database_saver_busy = 1;
+      g_async_queue_push(database_saver_todo, job);
+    }
+    else
+    {
+      dbsave_write(job);
+      database_saver_finish(job);
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_saver_start  --  start saver thread
+ * ------------------------------------------------------------------------- */
+
+static void
+database_saver_start(void)
+{
+  database_saver_todo = g_async_queue_new();
+  database_saver_done = g_async_queue_new();
+
+  GError *err = 0;
+
+  database_saver_thread = g_thread_try_new("profiled-saver",
+                                           database_saver_main, 0, &err);
+  if( database_saver_thread == 0 )
+  {
+    log_warning("saver thread: %s - saving synchronously\n",
+                err ? err->message : "failed");
+    g_clear_error(&err);
+  }
+}
 
+/* ------------------------------------------------------------------------- *
+ * database_saver_wait  --  wait until snapshot being written is finished
+ * ------------------------------------------------------------------------- */
 
-  if( !database_has_profile(database_current) )
+static void
+database_saver_wait(void)
+{
+  while( database_saver_busy && database_saver_thread != 0 )
   {
-    // switch back to default profile if the
-    // configuration updates happened to get
-    // rid of the currently active profile
-    xstrset(&database_current, *database_builtins);
+    database_saver_finish(g_async_queue_pop(database_saver_done));
   }
-
-  // send change notification if needed
-  database_notify_changes();
 }
 
 /* ------------------------------------------------------------------------- *
- * database_save  --  save all profile data
+ * database_saver_quit  --  finish pending saves and stop saver thread
+ *
+ * Returns nonzero if changes were made while the last snapshot was
+ * being written, i.e. if synchronous save is still needed.
  * ------------------------------------------------------------------------- */
 
 static int
-database_save_now(void)
+database_saver_quit(void)
 {
-  static int disabled = 0;
+  int again = database_saver_again;
 
-  int error = 0;
-
-  if( disabled )
+  if( database_saver_thread != 0 )
   {
-    log_warning("%s: saving disabled, ignoring save request\n", custom_path);
+    g_async_queue_push(database_saver_todo, &database_saver_stop);
+    g_thread_join(database_saver_thread), database_saver_thread = 0;
   }
-  else
-  {
-    if( !xcheckstats(custom_path,  &database_custom_stat) )
-    {
-      log_warning("%s: modified - disabling saving\n", custom_path);
-      disabled = 1;
-    }
 
-    if( !xcheckstats(current_path, &database_current_stat) )
-    {
-      log_warning("%s: modified - disabling saving\n", current_path);
-      disabled = 1;
-    }
+  g_idle_remove_by_data(&database_saver_done);
 
-    if( disabled )
+  if( database_saver_done != 0 )
+  {
+    dbsave_t *job;
+    while( (job = g_async_queue_try_pop(database_saver_done)) != 0 )
     {
-      database_restart_request();
+      database_saver_finish(job);
     }
+    g_async_queue_unref(database_saver_done), database_saver_done = 0;
   }
 
-  if( !disabled )
+  if( database_saver_todo != 0 )
   {
-    if( database_save_custom()  == -1 ) error = -1;
-    if( database_save_current() == -1 ) error = -1;
-
-    xfetchstats(custom_path,  &database_custom_stat);
-    xfetchstats(current_path, &database_current_stat);
+    g_async_queue_unref(database_saver_todo), database_saver_todo = 0;
   }
 
-  //log_crit_F("error=%d\n", error);
-  return error;
+  database_saver_again = 0;
+  return again;
 }
 
-static guint database_save_retry_id = 0;
-static guint database_save_later_id = 0;
+/* ------------------------------------------------------------------------- *
+ * database_get_setting  --  get non-negative number from daemon settings
+ * ------------------------------------------------------------------------- */
 
-static
-gboolean
-database_save_retry_cb(gpointer data)
+int
+database_get_setting(const char *key, int def)
 {
-  (void)data;
+  const char *str = inifile_get(database_static, SETTINGS, key, 0);
+  char       *end = 0;
+  long        val = def;
 
-  if( database_save_now() == -1 )
+  if( !xisempty(str) )
   {
-      return TRUE;
+    val = strtol(str, &end, 0);
+    if( *end != 0 || val < 0 || val > INT_MAX )
+    {
+      log_warning("[%s] %s = %s: invalid value, using default\n",
+                  SETTINGS, key, str);
+      val = def;
+    }
   }
-
-  log_warning("database save retry - success\n");
-  database_save_retry_id = 0;
-  return FALSE;
+  return (int)val;
 }
 
-static
-void
-database_save_cancel(void)
-{
-  if( database_save_later_id != 0 )
-  {
-    g_source_remove(database_save_later_id);
-    database_save_later_id = 0;
-  }
+/* ------------------------------------------------------------------------- *
+ * database_save_policy  --  apply save policy from static configuration
+ * ------------------------------------------------------------------------- */
 
-  if( database_save_retry_id != 0 )
+static void
+database_save_policy(void)
+{
+  savepolicy_t policy =
   {
-    log_warning("database save retry - cancelled\n");
-    g_source_remove(database_save_retry_id);
-    database_save_retry_id = 0;
-  }
+    .sp_window = database_get_setting(SETTINGS_SAVE_WINDOW, -1),
+    .sp_limit  = database_get_setting(SETTINGS_SAVE_LIMIT,  -1),
+    .sp_retry  = database_get_setting(SETTINGS_SAVE_RETRY,  -1),
+  };
+  savesched_set_policy(&policy);
 }
 
+/* ------------------------------------------------------------------------- *
+ * database_save_request  --  schedule asynchronous save of profile data
+ * ------------------------------------------------------------------------- */
+
 static
 void
 database_save_request(void)
 {
-  database_save_cancel();
-
-  if( database_save_now() == -1 )
-  {
-    log_warning("database save retry - started\n");
-    database_save_retry_id = g_timeout_add_seconds(RETRY_SAVE_PERIOD,
-                                                   database_save_retry_cb, 0);
-  }
+  savesched_request();
 }
 
-static
-gboolean
-database_save_later_cb(gpointer data)
+/* ------------------------------------------------------------------------- *
+ * database_save_flush  --  write all changes to flash before returning
+ * ------------------------------------------------------------------------- */
+
+int
+database_save_flush(void)
 {
-  (void)data;
+  int error = 0;
 
-  database_save_later_id = 0;
-  database_save_request();
-  return FALSE;
-}
+  savesched_cancel();
+  database_saver_wait();
+  database_saver_again = 0;
 
-static
-void
-database_save_later(int secs)
-{
-  if( database_save_later_id == 0 && database_save_retry_id == 0 )
-  {
-    if( secs < 1 ) secs = 1;
-    database_save_later_id = g_timeout_add_seconds(secs,
-                                                   database_save_later_cb, 0);
-  }
+  error = database_save_now();
+  savesched_finished(error);
+
+  return error;
 }
 
 static
@@ -830,6 +2127,15 @@ database_init(void)
   custom_path  = xstrfmt("%s/%s", datadir(), CUSTOM_INI);
   custom_work  = xstrfmt("%s.tmp", custom_path);
   custom_back  = xstrfmt("%s.bak", custom_path);
+  static_path  = xstrfmt("%s/%s", cachedir(), STATIC_DB);
+  journal_path = xstrfmt("%s/%s", datadir(), CUSTOM_LOG);
+
+  if( JOURNAL_COMPACT_SIZE > 0 )
+  {
+    database_journal = journal_create();
+  }
+
+  savesched_init(database_saver_submit);
 
   if( access(datadir(), F_OK) != 0 && access(legacydir(), F_OK) == 0 )
   {
@@ -842,10 +2148,14 @@ database_init(void)
   database_custom  = inifile_create();
 
   database_load();
+  database_resolved_refresh();
 
   // Make sure that $HOME/.profiled/current is always available
   database_save_now();
 
+  // further saving is done in the background
+  database_saver_start();
+
   xstrset(&database_previous, database_current);
 
   // generate and discard initial changeset
@@ -862,16 +2172,26 @@ database_init(void)
 void
 database_quit(void)
 {
-  // cancel pending retries
-  database_save_cancel();
+  // server_quit() has already requested save of the last changes,
+  // make sure they and anything written meanwhile reach flash
+  int pending = database_saver_quit();
 
-  // if there are unsaved changes to profile data,
-  // the save will be triggered by server_quit()
-  //database_save_now();
+  if( savesched_cancel() || pending )
+  {
+    database_save_now();
+  }
+  savesched_quit();
 
   xstrset(&database_previous, 0);
   xstrset(&database_current,  0);
 
+  database_resolved_flush();
+  database_flush_names();
+
+  symtab_delete(database_datatypes), database_datatypes = 0;
+
+  database_layers_flush();
+
   inifile_delete(database_static),  database_static  = 0;
   inifile_delete(database_custom),  database_custom  = 0;
 
@@ -882,6 +2202,25 @@ database_quit(void)
   xstrset(&current_path, 0);
   xstrset(&current_work, 0);
   xstrset(&current_back, 0);
+
+  xstrset(&static_path, 0);
+
+  journal_delete(database_journal), database_journal = 0;
+  xstrset(&journal_path, 0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_flush_names  --  drop cached profile and key names
+ * ------------------------------------------------------------------------- */
+
+static void
+database_flush_names(void)
+{
+  xfreev(database_profiles_cache), database_profiles_cache = 0;
+  xfreev(database_keys_cache),     database_keys_cache     = 0;
+
+  database_profiles_count = 0;
+  database_keys_count     = 0;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -899,47 +2238,41 @@ database_get_profiles_cb(const inisec_t *s, void *aptr)
   return 0;
 }
 
-char **
+const char * const *
 database_get_profiles(int *pcount)
 {
   /* Available profile names:
    * - default set of builtin profiles
    * - non special section names in static configuration files
+   *
+   * The returned array is owned by the database and stays
+   * valid until the configuration files are reloaded.
    */
 
-  char     **names = 0;
-  size_t     count = 0;
-  unique_t   unique;
+  if( database_profiles_cache == 0 )
+  {
+    unique_t unique;
 
-  unique_ctor(&unique);
+    unique_ctor(&unique);
 
-  inifile_scan_sections(database_static, database_get_profiles_cb, &unique);
+    inifile_scan_sections(database_static, database_get_profiles_cb, &unique);
 #if 0 // no need to scan custom values
-  inifile_scan_sections(database_custom, database_get_profiles_cb, &unique);
+    inifile_scan_sections(database_custom, database_get_profiles_cb, &unique);
 #endif
 
-  for( int i = 0; database_builtins[i]; ++i )
-  {
-    unique_add(&unique, database_builtins[i]);
-  }
-
-  names = unique_steal(&unique, &count);
-
-  unique_dtor(&unique);
+    for( int i = 0; database_builtins[i]; ++i )
+    {
+      unique_add(&unique, database_builtins[i]);
+    }
 
-  if( pcount ) *pcount = count;
+    database_profiles_cache = unique_steal(&unique, &database_profiles_count);
 
-  return names;
-}
+    unique_dtor(&unique);
+  }
 
-/* ------------------------------------------------------------------------- *
- * database_free_profiles
- * ------------------------------------------------------------------------- */
+  if( pcount ) *pcount = database_profiles_count;
 
-void
-database_free_profiles(char **profiles)
-{
-  xfreev(profiles);
+  return (const char * const *)database_profiles_cache;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -1046,41 +2379,35 @@ database_get_keys_cb(const inisec_t *s, const inival_t *v, void *aptr)
   return 0;
 }
 
-char **
+const char * const *
 database_get_keys(int *pcount)
 {
   /* Available key names:
    * - have both datatype and fallback value in static configuration files
+   *
+   * The returned array is owned by the database and stays
+   * valid until the configuration files are reloaded.
    */
 
-  char     **names = 0;
-  size_t     count = 0;
-  unique_t   unique;
-
-  unique_ctor(&unique);
-
-  inifile_scan_values(database_static, database_get_keys_cb, &unique);
+  if( database_keys_cache == 0 )
+  {
+    unique_t unique;
 
-  // no need to scan custom values
-  //inifile_scan_values(database_custom, database_get_keys_cb, &unique);
+    unique_ctor(&unique);
 
-  names = unique_steal(&unique, &count);
+    inifile_scan_values(database_static, database_get_keys_cb, &unique);
 
-  unique_dtor(&unique);
+    // no need to scan custom values
+    //inifile_scan_values(database_custom, database_get_keys_cb, &unique);
 
-  if( pcount ) *pcount = count;
+    database_keys_cache = unique_steal(&unique, &database_keys_count);
 
-  return names;
-}
+    unique_dtor(&unique);
+  }
 
-/* ------------------------------------------------------------------------- *
- * database_free_keys
- * ------------------------------------------------------------------------- */
+  if( pcount ) *pcount = database_keys_count;
 
-void
-database_free_keys(char **keys)
-{
-  xfreev(keys);
+  return (const char * const *)database_keys_cache;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -1120,9 +2447,20 @@ database_get_value(const char *profile,
   /* Getting value for non-existing profile yields fallback value */
 
   const char *res = 0;
+  resprof_t  *rp  = 0;
+
   database_check_profile(&profile);
 
-  if( database_has_value(key) )
+  if( (rp = database_resolved_profile(profile)) != 0 )
+  {
+    resval_t *rv = symtab_lookup(&rp->rp_values, key);
+    if( rv != 0 && rv->rv_type != 0 )
+    {
+      res = rv->rv_val;
+    }
+  }
+
+  if( res == 0 && database_has_value(key) )
   {
     res = current_(profile, key);
   }
@@ -1131,56 +2469,191 @@ database_get_value(const char *profile,
 }
 
 /* ------------------------------------------------------------------------- *
- * database_set_value
+ * database_check_value  --  check if value can be set
  * ------------------------------------------------------------------------- */
 
-int
-database_set_value(const char *profile,
-                   const char *key,
-                   const char *val)
+static int
+database_check_value(const char *profile, const char *key, const char *val)
 {
-  /* Value will be changed only if the profile and key exist.
-   *
-   * If the key is not writable, the value will be stored, but
+  /* Value can be changed only if the profile and key exist,
+   * and the value is either empty (= reset to default) or
+   * valid for the datatype of the key. */
+
+  int               res = -1;
+  const datatype_t *dt  = 0;
+  char             *use = xstrip(strdup(val ?: ""));
+
+  if( !database_has_profile(profile) || !database_has_value(key) )
+  {
+    goto cleanup;
+  }
+
+  dt = compiled_(key);
+
+  if( !xisempty(use) && datatype_parse(dt, use, 0) < 0 )
+  {
+    log_warning("%s: %s: value '%s' does not match datatype '%s'\n",
+                profile, key, use, dt->dt_spec);
+    goto cleanup;
+  }
+
+  res = 0;
+
+cleanup:
+  free(use);
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_apply_value  --  store already validated value
+ *
+ * Returns: 0 if nothing changed, 1 if change notification is needed
+ * or 2 if the stored value just needs to be saved.
+ * ------------------------------------------------------------------------- */
+
+static int
+database_apply_value(const char *profile, const char *key, const char *val)
+{
+  /* If the key is not writable, the value will be stored, but
    * will not take effect until the key becomes writeble. In
    * practice this means removal of configuration file that
    * declares [override] value for the key.
    */
 
+  int               res  = 0;
+  const datatype_t *dt   = compiled_(key);
+  const char       *cus  = custom_(profile, key);
+  const char       *cur  = current_(profile, key);
+  char             *use  = xstrip(strdup(val ?: ""));
+  resprof_t        *rp   = database_resolved_profile(profile);
+  resval_t         *rv   = rp ? symtab_lookup(&rp->rp_values, key) : 0;
+  int               same = 0;
+  datavalue_t       data;
+
+  /* compare against the stored typed value if there is one,
+   * otherwise both strings need to be parsed */
+  if( rv != 0 && rv->rv_typed && rv->rv_val == cur )
+  {
+    same = (xstrsame(cur, use) ||
+            (datatype_parse(dt, use, &data) == 0 &&
+             datatype_equal(dt, &rv->rv_data, &data)));
+  }
+  else
+  {
+    same = datatype_same(dt, cur, use);
+  }
+
+  /* differs from current value, or custom value not set */
+  if( !same || xstrnull(cus) )
+  {
+    // set custom data
+    inifile_set(database_custom,  profile, key, use);
+    database_resolved_patch(profile, key);
+
+    if( database_journal != 0 )
+    {
+      journal_add(database_journal, profile, key, use);
+    }
+
+    // notify changes, or just make sure the changes get saved
+    res = database_is_writable(key) ? 1 : 2;
+  }
+  free(use);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_commit_values  --  notify or save after applying values
+ * ------------------------------------------------------------------------- */
+
+static void
+database_commit_values(int notify, int save)
+{
+  if( notify )
+  {
+    database_notify_changes();
+  }
+  else if( save )
+  {
+    database_save_request();
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_set_value
+ * ------------------------------------------------------------------------- */
+
+int
+database_set_value(const char *profile,
+                   const char *key,
+                   const char *val)
+{
   int res = -1;
 
   database_check_profile(&profile);
 
-  if( database_has_profile(profile) )
+  if( database_check_value(profile, key, val) == 0 )
+  {
+    int chg = database_apply_value(profile, key, val);
+    database_commit_values(chg == 1, chg == 2);
+    res = 0;
+  }
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * database_set_values  --  set several values as one transaction
+ *
+ * The triplets array holds count (profile, key, value) string
+ * triplets. Either all values are set or none of them, and all
+ * the changes are reported in one changeset.
+ * ------------------------------------------------------------------------- */
+
+int
+database_set_values(const char * const *triplets, int count)
+{
+  int res    = -1;
+  int notify = 0;
+  int save   = 0;
+
+  for( int i = 0; i < count; ++i )
   {
-    if( database_has_value(key) )
+    const char *profile = triplets[3*i + 0];
+    const char *key     = triplets[3*i + 1];
+    const char *val     = triplets[3*i + 2];
+
+    database_check_profile(&profile);
+
+    if( database_check_value(profile, key, val) < 0 )
     {
-      const char *cus = custom_(profile, key);
-      const char *cur = current_(profile, key);
-      char       *use = xstrip(strdup(val ?: ""));
+      log_warning("set_values: %s: %s: rejected, nothing changed\n",
+                  profile, key);
+      goto cleanup;
+    }
+  }
 
-      /* differs from current value, or custom value not set */
-      if( !xstrsame(cur, use) || xstrnull(cus) )
-      {
-        // set custom data
-        inifile_set(database_custom,  profile, key, use);
+  for( int i = 0; i < count; ++i )
+  {
+    const char *profile = triplets[3*i + 0];
+    const char *key     = triplets[3*i + 1];
+    const char *val     = triplets[3*i + 2];
 
-        if( database_is_writable(key) )
-        {
-          // notify changes
-          database_notify_changes();
-        }
-        else
-        {
-          // just make sure the changes get saved
-          database_save_later(1);
-        }
-      }
-      free(use);
-      res = 0;
+    database_check_profile(&profile);
+
+    switch( database_apply_value(profile, key, val) )
+    {
+    case 1: notify = 1; break;
+    case 2: save   = 1; break;
+    default: break;
     }
   }
 
+  database_commit_values(notify, save);
+  res = 0;
+
+cleanup:
   return res;
 }
 
@@ -1208,28 +2681,48 @@ database_get_values(const char *profile, int *pcount)
    * If the profile does not exist, fallback values
    * will be returned.
    */
-  int           keys = 0;
-  char        **key  = database_get_keys(&keys);
-
   int           cnt = 0;
-  profileval_t *vec  = calloc(keys + 1, sizeof *vec);
+  profileval_t *vec = 0;
+  resprof_t    *rp  = 0;
 
   database_check_profile(&profile);
 
-  for( int i = 0; i < keys; ++i )
+  if( (rp = database_resolved_profile(profile)) != 0 )
   {
-    const char *k = key[i];
-    const char *v = current_(profile, k);
-    const char *t = datatype_(k);
+    resval_t * const *tab = resprof_sorted(rp);
 
-    if( k != 0 && v != 0 && t != 0 )
+    vec = calloc(rp->rp_values.st_count + 1, sizeof *vec);
+
+    for( size_t i = 0; tab[i]; ++i )
     {
-      profileval_ctor_ex(&vec[cnt++], k, v, t);
+      resval_t *rv = tab[i];
+
+      if( rv->rv_val != 0 && rv->rv_type != 0 )
+      {
+        profileval_ctor_ex(&vec[cnt++], rv->rv_key, rv->rv_val, rv->rv_type);
+      }
     }
   }
-  profileval_ctor(&vec[cnt]);
+  else
+  {
+    int                 keys = 0;
+    const char * const *key  = database_get_keys(&keys);
+
+    vec = calloc(keys + 1, sizeof *vec);
+
+    for( int i = 0; i < keys; ++i )
+    {
+      const char *k = key[i];
+      const char *v = current_(profile, k);
+      const char *t = datatype_(k);
 
-  database_free_keys(key);
+      if( k != 0 && v != 0 && t != 0 )
+      {
+        profileval_ctor_ex(&vec[cnt++], k, v, t);
+      }
+    }
+  }
+  profileval_ctor(&vec[cnt]);
 
   if( pcount ) *pcount = cnt;
   return vec;
@@ -1245,9 +2738,8 @@ database_free_values(profileval_t *values)
   profileval_free_vector(values);
 }
 
-static inifile_t *bc_state_prev = 0;
-static inifile_t *bc_state_curr = 0;
-static inifile_t *bc_state_diff = 0;
+static inifile_t *bc_state_diff  = 0; // pending changeset
+static unsigned   bc_state_gen   = 0; // generation of last changeset
 
 /* ------------------------------------------------------------------------- *
  * database_clear_changes
@@ -1260,8 +2752,8 @@ database_clear_changes(void)
   xstrset(&database_previous, database_current);
   inifile_delete(bc_state_diff), bc_state_diff = 0;
 
-  /* Save state information, if it fails it will be
-   * periodically retried until it succeeds */
+  /* Save state information, the save scheduler batches
+   * changes and retries failed saves until they succeed */
   database_save_request();
 }
 
@@ -1272,21 +2764,16 @@ database_clear_changes(void)
 static void
 database_generate_changes(void)
 {
-  char **prof = 0;
-  char **key  = 0;
-
   if( bc_state_diff )
   {
     // already have delta set
     goto cleanup;
   }
 
-  inifile_delete(bc_state_prev);
-  bc_state_prev = bc_state_curr ?: inifile_create();
-  bc_state_curr = inifile_create();
-  bc_state_diff = inifile_create();
+  bc_state_diff = inifile_create_arena();
 
-  /* Scan changeset for keys with changed values.
+  /* Scan changeset for values stamped after the previous
+   * changeset was generated.
    *
    * Special case: if the active profile has changed,
    * values of all keys will be included
@@ -1296,45 +2783,39 @@ database_generate_changes(void)
    * with empty value and datatype.
    */
 
-  // accumulate changed values
-  prof = database_get_profiles(0);
-  key  = database_get_keys(0);
-  for( int p = 0; prof && prof[p]; ++p )
+  int force = !xstrsame(database_current, database_previous);
+
+  if( force )
+  {
+    // make sure the active profile is resolved
+    database_resolved_profile(database_current);
+  }
+
+  for( size_t i = 0; database_resolved && i < database_resolved->st_count; ++i )
   {
-    int force = (!xstrsame(database_current, database_previous) &&
-		 xstrsame(database_current, prof[p]));
+    resprof_t *rp  = database_resolved->st_elem[i];
+    int        all = force && xstrsame(rp->rp_name, database_current);
 
-    for( int k = 0; key && key[k]; ++k )
+    if( !all && rp->rp_gen <= bc_state_gen )
     {
-      const char *v_curr = database_get_value(prof[p], key[k], "");
-      const char *v_prev = inifile_get(bc_state_prev, prof[p], key[k], "");
-      inifile_set(bc_state_curr, prof[p], key[k], v_curr);
-      if( force || !xstrsame(v_prev, v_curr) )
-      {
-	inifile_set(bc_state_diff, prof[p], key[k], v_curr);
-      }
+      continue;
     }
-  }
-  database_free_keys(key), key = 0;
-  database_free_profiles(prof), prof = 0;
 
-  // accumulate dropped values
-  prof = inifile_get_section_names(bc_state_prev, 0);
-  key  = inifile_get_value_keys(bc_state_prev, 0);
-  for( int p = 0; prof && prof[p]; ++p )
-  {
-    for( int k = 0; key && key[k]; ++k )
+    for( size_t k = 0; k < rp->rp_values.st_count; ++k )
     {
-      const char *v_prev = inifile_get(bc_state_prev, prof[p], key[k], 0);
-      const char *v_curr = inifile_get(bc_state_curr, prof[p], key[k], 0);
-      if( v_prev && !v_curr )
+      resval_t *rv = rp->rp_values.st_elem[k];
+
+      if( all || rv->rv_gen > bc_state_gen )
       {
-	inifile_set(bc_state_diff, prof[p], key[k], "");
+        inifile_set(bc_state_diff, rp->rp_name, rv->rv_key, rv->rv_val ?: "");
       }
     }
   }
-  database_free_keys(key), key = 0;
-  database_free_profiles(prof), prof = 0;
+
+  bc_state_gen = database_generation;
+
+  // dropped values have been included in the changeset
+  database_resolved_purge();
 
 cleanup:
   return;
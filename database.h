@@ -44,6 +44,23 @@
 
 # define CONFIG_DIR  FS"/etc/profiled"
 
+/* static configuration files and snapshot made by profiled-compile */
+# define CONFIG_PATTERN  "[0-9][0-9].*.ini"
+# define CONFIG_GLOB     CONFIG_DIR"/"CONFIG_PATTERN
+# define CONFIG_SNAPSHOT CONFIG_DIR"/profiled.db"
+
+/* sections that can be modified only via configuration files */
+# define OVERRIDE "override"
+# define FALLBACK "fallback"
+# define DATATYPE "datatype"
+
+/* daemon settings, e.g. save policy */
+# define SETTINGS "profiled"
+# define SETTINGS_SAVE_WINDOW "save.window"  // [ms] batching window
+# define SETTINGS_SAVE_LIMIT  "save.limit"   // max saves per hour
+# define SETTINGS_SAVE_RETRY  "save.retry"   // [s] first retry delay
+# define SETTINGS_DIRECT      "direct"       // peer-to-peer socket 0/1
+
 # ifdef __cplusplus
 extern "C" {
 # elif 0
@@ -53,21 +70,20 @@ extern "C" {
 int             database_init                 (void);
 void            database_quit                 (void);
 
-char          **database_get_profiles         (int *pcount);
-void            database_free_profiles        (char **profiles);
+const char * const *database_get_profiles    (int *pcount);
 
 const char     *database_get_profile          (void);
 const char     *database_get_previous         (void);
 int             database_set_profile          (const char *profile);
 int             database_has_profile          (const char *profile);
 
-char          **database_get_keys             (int *pcount);
-void            database_free_keys            (char **keys);
+const char * const *database_get_keys        (int *pcount);
 
 int             database_has_value            (const char *key);
 int             database_is_writable          (const char *key);
 const char     *database_get_value            (const char *profile, const char *key, const char *val);
 int             database_set_value            (const char *profile, const char *key, const char *val);
+int             database_set_values           (const char * const *triplets, int count);
 const char     *database_get_type             (const char *key, const char *def);
 profileval_t   *database_get_values           (const char *profile, int *pcount);
 void            database_free_values          (profileval_t *values);
@@ -82,9 +98,14 @@ profileval_t   *database_get_changed_values   (const char *profile, int *pcount)
 void            database_free_changed_values  (profileval_t *values);
 
 void            database_reload(void);
+void            database_reload_files(const char * const *names, int count);
+
+int             database_save_flush           (void);
 
 void            database_set_restart_request_cb(void (*cb)(void));
 
+int             database_get_setting          (const char *key, int def);
+
 # ifdef __cplusplus
 };
 # endif
@@ -0,0 +1,471 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include "profiled_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "datatype.h"
+#include "atom.h"
+#include "xutil.h"
+
+/* ========================================================================= *
+ * Boolean Vocabulary
+ * ========================================================================= */
+
+/* Same values as accepted by profile_parse_bool() in libprofile */
+
+static const char * const datatype_true_values[] =
+{
+  "On", "True", "Yes", "Y", "T", 0
+};
+
+static const char * const datatype_false_values[] =
+{
+  "Off", "False", "No", "N", "F", 0
+};
+
+/* ========================================================================= *
+ * Type Names
+ * ========================================================================= */
+
+static const struct
+{
+  const char *name;
+  int         kind;
+} datatype_names[] =
+{
+  { "STRING",  DATATYPE_STRING  },
+  { "INTEGER", DATATYPE_INTEGER },
+  { "INT",     DATATYPE_INTEGER },
+  { "DOUBLE",  DATATYPE_DOUBLE  },
+  { "BOOLEAN", DATATYPE_BOOLEAN },
+  { "BOOL",    DATATYPE_BOOLEAN },
+  { 0,         DATATYPE_ANY     }
+};
+
+/* ========================================================================= *
+ * Utilities
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * datatype_token  --  extract whitespace separated, possibly quoted token
+ * ------------------------------------------------------------------------- */
+
+static char *
+datatype_token(char **ppos)
+{
+  char *pos = *ppos;
+
+  while( xiswhite(*pos) ) ++pos;
+
+  if( *pos == 0 )
+  {
+    *ppos = pos;
+    return 0;
+  }
+
+  char *res = pos;
+
+  if( *pos == '"' )
+  {
+    res = ++pos;
+    while( *pos && *pos != '"' ) ++pos;
+  }
+  else
+  {
+    while( xisblack(*pos) ) ++pos;
+  }
+
+  if( *pos != 0 ) *pos++ = 0;
+
+  *ppos = pos;
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_number  --  parse complete string as number
+ *
+ * Integers are parsed with base 0 like profile_get_value_as_int()
+ * does, so "0x10" equals "16" and "050" equals "40", not "50".
+ * ------------------------------------------------------------------------- */
+
+static int
+datatype_number(const char *str, int integer, datavalue_t *pval)
+{
+  char *end = 0;
+
+  if( integer )
+  {
+    long num = strtol(str, &end, 0);
+    pval->dv_int = num;
+    pval->dv_dbl = num;
+  }
+  else
+  {
+    double num = strtod(str, &end);
+    pval->dv_int = (long)num;
+    pval->dv_dbl = num;
+  }
+
+  return (end > str && *end == 0) ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_range  --  parse "min-max" or "min/max[/step]" range spec
+ * ------------------------------------------------------------------------- */
+
+static int
+datatype_range(datatype_t *self, const char *str)
+{
+  char  *end = 0;
+  double lo  = strtod(str, &end);
+
+  if( end == str || (*end != '-' && *end != '/') )
+  {
+    return -1;
+  }
+
+  int    sep = *end;
+  char  *beg = end + 1;
+  double hi  = strtod(beg, &end);
+  double st  = 0;
+
+  if( end == beg )
+  {
+    return -1;
+  }
+
+  if( sep == '/' && *end == '/' )
+  {
+    beg = end + 1;
+    st  = strtod(beg, &end);
+    if( end == beg ) return -1;
+  }
+
+  if( *end != 0 )
+  {
+    return -1;
+  }
+
+  self->dt_ranged = 1;
+  self->dt_min    = lo;
+  self->dt_max    = hi;
+  self->dt_step   = st;
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_boolean  --  parse boolean vocabulary
+ * ------------------------------------------------------------------------- */
+
+static int
+datatype_boolean(const char *str, datavalue_t *pval)
+{
+  for( size_t i = 0; datatype_true_values[i]; ++i )
+  {
+    if( !strcasecmp(datatype_true_values[i], str) )
+    {
+      pval->dv_int = 1, pval->dv_dbl = 1;
+      return 0;
+    }
+  }
+
+  for( size_t i = 0; datatype_false_values[i]; ++i )
+  {
+    if( !strcasecmp(datatype_false_values[i], str) )
+    {
+      pval->dv_int = 0, pval->dv_dbl = 0;
+      return 0;
+    }
+  }
+
+  if( datatype_number(str, 1, pval) == 0 )
+  {
+    pval->dv_int = pval->dv_dbl = (pval->dv_int != 0);
+    return 0;
+  }
+
+  return -1;
+}
+
+/* ========================================================================= *
+ * datatype_t  --  methods
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * datatype_create  --  compile datatype specification
+ * ------------------------------------------------------------------------- */
+
+datatype_t *
+datatype_create(const char *spec)
+{
+  datatype_t *self = calloc(1, sizeof *self);
+  char       *work = strdup(spec ?: "");
+  char       *pos  = work;
+  char       *tok  = 0;
+
+  self->dt_spec  = atom_intern(spec);
+  self->dt_kind  = DATATYPE_ANY;
+  self->dt_count = 0;
+  self->dt_enum  = 0;
+
+  if( (tok = datatype_token(&pos)) != 0 )
+  {
+    for( size_t i = 0; datatype_names[i].name; ++i )
+    {
+      if( !strcasecmp(datatype_names[i].name, tok) )
+      {
+        self->dt_kind = datatype_names[i].kind;
+        break;
+      }
+    }
+  }
+
+  while( (tok = datatype_token(&pos)) != 0 )
+  {
+    if( self->dt_count == 0 && !self->dt_ranged &&
+        (self->dt_kind == DATATYPE_INTEGER ||
+         self->dt_kind == DATATYPE_DOUBLE) &&
+        datatype_range(self, tok) == 0 )
+    {
+      continue;
+    }
+
+    self->dt_enum = realloc(self->dt_enum,
+                            (self->dt_count + 1) * sizeof *self->dt_enum);
+    self->dt_enum[self->dt_count++] = atom_intern(tok);
+  }
+
+  free(work);
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_delete
+ * ------------------------------------------------------------------------- */
+
+void
+datatype_delete(datatype_t *self)
+{
+  if( self != 0 )
+  {
+    for( size_t i = 0; i < self->dt_count; ++i )
+    {
+      atom_release(self->dt_enum[i]);
+    }
+    free(self->dt_enum);
+    atom_release(self->dt_spec);
+    free(self);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_delete_cb
+ * ------------------------------------------------------------------------- */
+
+void
+datatype_delete_cb(void *self)
+{
+  datatype_delete(self);
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_create_cb
+ * ------------------------------------------------------------------------- */
+
+void *
+datatype_create_cb(const char *spec)
+{
+  return datatype_create(spec);
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_getkey_cb
+ * ------------------------------------------------------------------------- */
+
+const char *
+datatype_getkey_cb(const void *self)
+{
+  return ((const datatype_t *)self)->dt_spec;
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_parse  --  validate value and convert it to typed form
+ *
+ * Returns 0 if the value is valid for the datatype, or -1 if not.
+ * ------------------------------------------------------------------------- */
+
+int
+datatype_parse(const datatype_t *self, const char *val, datavalue_t *pval)
+{
+  datavalue_t tmp = { 0, 0 };
+  int         res = -1;
+
+  if( val == 0 )
+  {
+    goto cleanup;
+  }
+
+  switch( self->dt_kind )
+  {
+  case DATATYPE_INTEGER:
+  case DATATYPE_DOUBLE:
+    {
+      int integer = (self->dt_kind == DATATYPE_INTEGER);
+
+      if( datatype_number(val, integer, &tmp) < 0 )
+      {
+        goto cleanup;
+      }
+
+      if( self->dt_ranged )
+      {
+        if( tmp.dv_dbl < self->dt_min || tmp.dv_dbl > self->dt_max )
+        {
+          goto cleanup;
+        }
+        if( self->dt_step > 0 &&
+            fmod(tmp.dv_dbl - self->dt_min, self->dt_step) != 0 )
+        {
+          goto cleanup;
+        }
+      }
+
+      if( self->dt_count != 0 )
+      {
+        size_t i = 0;
+        for( ; i < self->dt_count; ++i )
+        {
+          datavalue_t alt;
+          if( datatype_number(self->dt_enum[i], integer, &alt) == 0 &&
+              alt.dv_dbl == tmp.dv_dbl )
+          {
+            break;
+          }
+        }
+        if( i == self->dt_count )
+        {
+          goto cleanup;
+        }
+      }
+    }
+    break;
+
+  case DATATYPE_BOOLEAN:
+    if( datatype_boolean(val, &tmp) < 0 )
+    {
+      goto cleanup;
+    }
+    break;
+
+  case DATATYPE_STRING:
+    if( self->dt_count != 0 )
+    {
+      size_t i = 0;
+      for( ; i < self->dt_count; ++i )
+      {
+        if( !strcmp(self->dt_enum[i], val) ) break;
+      }
+      if( i == self->dt_count )
+      {
+        goto cleanup;
+      }
+      tmp.dv_int = (long)i;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  res = 0;
+
+cleanup:
+  if( pval ) *pval = tmp;
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_equal  --  check if two parsed values are equal
+ *
+ * Only numeric and boolean values have a typed form, for other kinds
+ * the string values must be compared instead.
+ * ------------------------------------------------------------------------- */
+
+int
+datatype_equal(const datatype_t *self, const datavalue_t *d1,
+               const datavalue_t *d2)
+{
+  switch( self->dt_kind )
+  {
+  case DATATYPE_INTEGER:
+  case DATATYPE_DOUBLE:
+  case DATATYPE_BOOLEAN:
+    return d1->dv_dbl == d2->dv_dbl;
+  default:
+    break;
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * datatype_same  --  check if two values are equal in typed form
+ * ------------------------------------------------------------------------- */
+
+int
+datatype_same(const datatype_t *self, const char *v1, const char *v2)
+{
+  datavalue_t d1, d2;
+
+  if( xstrsame(v1, v2) )
+  {
+    return 1;
+  }
+
+  switch( self->dt_kind )
+  {
+  case DATATYPE_INTEGER:
+  case DATATYPE_DOUBLE:
+  case DATATYPE_BOOLEAN:
+    return (datatype_parse(self, v1, &d1) == 0 &&
+            datatype_parse(self, v2, &d2) == 0 &&
+            datatype_equal(self, &d1, &d2));
+  default:
+    break;
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef DATATYPE_H_
+# define DATATYPE_H_
+
+# include <stddef.h>
+
+# ifdef __cplusplus
+extern "C" {
+# elif 0
+} /* fool JED indentation ... */
+# endif
+
+typedef struct datatype_t  datatype_t;
+typedef struct datavalue_t datavalue_t;
+
+/* ------------------------------------------------------------------------- *
+ * datatype_t  --  compiled [datatype] specification
+ *
+ * Specifications are of form: <typename> [<rangespec> | <listspec>]
+ *
+ *   rangespec: <number>'-'<number> or <number>'/'<number>['/'<step>]
+ *   listspec:  <value> [<value>] ..., values can be "double quoted"
+ *
+ * INTEGER, DOUBLE, BOOLEAN and STRING values are validated, other
+ * type names (SOUNDFILE etc) are just hints for UI and accept any
+ * value.
+ * ------------------------------------------------------------------------- */
+
+enum
+{
+  DATATYPE_ANY,
+  DATATYPE_STRING,
+  DATATYPE_INTEGER,
+  DATATYPE_DOUBLE,
+  DATATYPE_BOOLEAN,
+};
+
+struct datatype_t
+{
+  const char  *dt_spec;   // atom, specification as configured
+  int          dt_kind;   // DATATYPE_xxx
+
+  int          dt_ranged; // dt_min ... dt_max, dt_step applies if > 0
+  double       dt_min;
+  double       dt_max;
+  double       dt_step;
+
+  size_t       dt_count;  // number of enumerated values
+  const char **dt_enum;   // atoms, enumerated values
+};
+
+/* ------------------------------------------------------------------------- *
+ * datavalue_t  --  value in typed form
+ * ------------------------------------------------------------------------- */
+
+struct datavalue_t
+{
+  long   dv_int; // INTEGER and BOOLEAN values
+  double dv_dbl; // DOUBLE values, INTEGER values as double
+};
+
+datatype_t *datatype_create   (const char *spec);
+void        datatype_delete   (datatype_t *self);
+void        datatype_delete_cb(void *self);
+void       *datatype_create_cb(const char *spec);
+const char *datatype_getkey_cb(const void *self);
+int         datatype_parse    (const datatype_t *self, const char *val, datavalue_t *pval);
+int         datatype_same     (const datatype_t *self, const char *v1, const char *v2);
+int         datatype_equal    (const datatype_t *self, const datavalue_t *d1, const datavalue_t *d2);
+
+# ifdef __cplusplus
+};
+# endif
+
+#endif /* DATATYPE_H_ */
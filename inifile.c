@@ -62,7 +62,7 @@ inival_emit(const inival_t *self, FILE *file)
 void
 inival_set(inival_t *self, const char *val)
 {
-  xstrset(&self->iv_val, val);
+  atom_set(&self->iv_val, val);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -74,8 +74,8 @@ inival_create(const char *key, const char *val)
 {
   inival_t *self = calloc(1, sizeof *self);
 
-  self->iv_key = strdup(key ?: "");
-  self->iv_val = strdup(val ?: "");
+  self->iv_key = atom_intern(key);
+  self->iv_val = atom_intern(val);
 
   return self;
 }
@@ -89,8 +89,8 @@ inival_delete(inival_t *self)
 {
   if( self != 0 )
   {
-    free(self->iv_key);
-    free(self->iv_val);
+    atom_release(self->iv_key);
+    atom_release(self->iv_val);
     free(self);
   }
 }
@@ -126,6 +126,35 @@ inival_create_cb(const char *key)
   return inival_create(key, "");
 }
 
+/* ------------------------------------------------------------------------- *
+ * inival_create_arena_cb  --  create value in arena
+ * ------------------------------------------------------------------------- */
+
+static
+void *
+inival_create_arena_cb(void *arena, const char *key)
+{
+  inival_t *self = arena_alloc(arena, sizeof *self);
+
+  self->iv_key = atom_intern(key);
+  self->iv_val = atom_intern("");
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * inival_release_cb  --  drop references held by value in arena
+ * ------------------------------------------------------------------------- */
+
+static
+void
+inival_release_cb(void *self)
+{
+  inival_t *val = self;
+  atom_release(val->iv_key);
+  atom_release(val->iv_val);
+}
+
 /* ------------------------------------------------------------------------- *
  * inival_getkey_cb
  * ------------------------------------------------------------------------- */
@@ -149,11 +178,12 @@ void
 inisec_ctor(inisec_t *self)
 {
   self->is_name   = 0;
+  self->is_arena  = 0;
 
-  symtab_ctor(&self->is_values,
-              inival_create_cb,
-              inival_delete_cb,
-              inival_getkey_cb);
+  symtab_ctor_atoms(&self->is_values,
+                    inival_create_cb,
+                    inival_delete_cb,
+                    inival_getkey_cb);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -165,7 +195,7 @@ inisec_dtor(inisec_t *self)
 {
   symtab_dtor(&self->is_values);
 
-  free(self->is_name);
+  atom_release(self->is_name);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -249,6 +279,39 @@ inisec_create_cb(const char *name)
   return inisec_create(name);
 }
 
+/* ------------------------------------------------------------------------- *
+ * inisec_create_arena_cb  --  create section in arena
+ * ------------------------------------------------------------------------- */
+
+static
+void *
+inisec_create_arena_cb(void *arena, const char *name)
+{
+  inisec_t *self = arena_alloc(arena, sizeof *self);
+  inisec_ctor(self);
+
+  self->is_arena = arena;
+  symtab_set_context(&self->is_values,
+                     inival_create_arena_cb,
+                     inival_release_cb,
+                     arena);
+
+  inisec_set_name(self, name);
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * inisec_release_cb  --  destroy section in arena without freeing it
+ * ------------------------------------------------------------------------- */
+
+static
+void
+inisec_release_cb(void *self)
+{
+  inisec_dtor(self);
+}
+
 /* ------------------------------------------------------------------------- *
  * inisec_set
  * ------------------------------------------------------------------------- */
@@ -260,6 +323,17 @@ inisec_set(inisec_t *self, const char *key, const char *val)
   inival_set(res, val);
 }
 
+/* ------------------------------------------------------------------------- *
+ * inisec_append  --  set value without hash index update, for bulk loads
+ * ------------------------------------------------------------------------- */
+
+void
+inisec_append(inisec_t *self, const char *key, const char *val)
+{
+  inival_t *res = symtab_append(&self->is_values, key);
+  inival_set(res, val);
+}
+
 /* ------------------------------------------------------------------------- *
  * inisec_get
  * ------------------------------------------------------------------------- */
@@ -298,19 +372,21 @@ inisec_del(inisec_t *self, const char *key)
 int
 inisec_emit(const inisec_t *self, FILE *file)
 {
-  int err = -1;
+  int    err = -1;
+  void **val = symtab_sorted(&self->is_values);
 
   if( fprintf(file, "%c%s%c\n\n", BRA, self->is_name, KET) < 0 ) goto cleanup;
 
-  for( size_t i = 0; i < self->is_values.st_count; ++i )
+  for( size_t i = 0; val[i]; ++i )
   {
-    if( inival_emit(self->is_values.st_elem[i], file) < 0 ) goto cleanup;
+    if( inival_emit(val[i], file) < 0 ) goto cleanup;
   }
 
   if( fprintf(file, "\n") < 0 ) goto cleanup;
 
   err = 0;
   cleanup:
+  free(val);
   return err;
 }
 
@@ -345,12 +421,30 @@ inifile_set_path(inifile_t *self, const char *path)
 void
 inifile_ctor(inifile_t *self)
 {
-  self->if_path = 0;
+  self->if_path  = 0;
+  self->if_arena = 0;
+
+  symtab_ctor_atoms(&self->if_sections,
+                    inisec_create_cb,
+                    inisec_delete_cb,
+                    inisec_getkey_cb);
+}
+
+/* ------------------------------------------------------------------------- *
+ * inifile_ctor_arena  --  sections and values are allocated from arena
+ * ------------------------------------------------------------------------- */
+
+void
+inifile_ctor_arena(inifile_t *self)
+{
+  inifile_ctor(self);
 
-  symtab_ctor(&self->if_sections,
-              inisec_create_cb,
-              inisec_delete_cb,
-              inisec_getkey_cb);
+  self->if_arena = arena_create(0);
+
+  symtab_set_context(&self->if_sections,
+                     inisec_create_arena_cb,
+                     inisec_release_cb,
+                     self->if_arena);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -360,8 +454,12 @@ inifile_ctor(inifile_t *self)
 void
 inifile_dtor(inifile_t *self)
 {
+  /* for arena mode this just drops atom references, the
+   * memory is released in one go after that */
   symtab_dtor(&self->if_sections);
 
+  arena_delete(self->if_arena), self->if_arena = 0;
+
   free(self->if_path);
 }
 
@@ -377,6 +475,18 @@ inifile_create(void)
   return self;
 }
 
+/* ------------------------------------------------------------------------- *
+ * inifile_create_arena
+ * ------------------------------------------------------------------------- */
+
+inifile_t *
+inifile_create_arena(void)
+{
+  inifile_t *self = calloc(1, sizeof *self);
+  inifile_ctor_arena(self);
+  return self;
+}
+
 /* ------------------------------------------------------------------------- *
  * inifile_delete
  * ------------------------------------------------------------------------- */
@@ -536,14 +646,17 @@ inifile_has(inifile_t *self, const char *sec, const char *key)
 int
 inifile_emit(const inifile_t *self, FILE *file)
 {
-  int err = 0;
-  for( size_t i = 0; i < self->if_sections.st_count; ++i )
+  int    err = 0;
+  void **sec = symtab_sorted(&self->if_sections);
+
+  for( size_t i = 0; sec[i]; ++i )
   {
-    if( inisec_emit(self->if_sections.st_elem[i], file) < 0 )
+    if( inisec_emit(sec[i], file) < 0 )
     {
       err = -1; break;
     }
   }
+  free(sec);
   return err;
 }
 
@@ -648,6 +761,43 @@ inifile_save_to_memory(const inifile_t *self, char **pdata, size_t *psize,
   return err;
 }
 
+/* ------------------------------------------------------------------------- *
+ * inifile_merge  --  bulk append sections and values of another inifile
+ *
+ * Like inifile_load_bulk(), but the values come from an already
+ * loaded inifile. Finish with inifile_reindex().
+ * ------------------------------------------------------------------------- */
+
+void
+inifile_merge(inifile_t *self, const inifile_t *layer)
+{
+  for( size_t i = 0; i < layer->if_sections.st_count; ++i )
+  {
+    const inisec_t *src = layer->if_sections.st_elem[i];
+    inisec_t       *dst = inifile_add_section(self, src->is_name);
+
+    for( size_t k = 0; k < src->is_values.st_count; ++k )
+    {
+      const inival_t *val = src->is_values.st_elem[k];
+      inisec_append(dst, val->iv_key, val->iv_val);
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * inifile_reindex  --  finish bulk load started with inifile_load_bulk()
+ * ------------------------------------------------------------------------- */
+
+void
+inifile_reindex(inifile_t *self)
+{
+  for( size_t i = 0; i < self->if_sections.st_count; ++i )
+  {
+    inisec_t *sec = self->if_sections.st_elem[i];
+    symtab_reindex(&sec->is_values);
+  }
+}
+
 /* ------------------------------------------------------------------------- *
  * inifile_load
  * ------------------------------------------------------------------------- */
@@ -655,59 +805,116 @@ inifile_save_to_memory(const inifile_t *self, char **pdata, size_t *psize,
 int
 inifile_load(inifile_t *self, const char *path)
 {
-  int     err  = -1;
-  FILE   *file = 0;
-  size_t  size = 0;
-  char   *data = 0;
+  int err = inifile_load_bulk(self, path);
+  inifile_reindex(self);
+  return err;
+}
 
-  inisec_t *sec = 0;
-  char     *key = 0;
-  char     *val = 0;
+/* ------------------------------------------------------------------------- *
+ * inifile_parse_line  --  handle one line of ini file content
+ *
+ * The line is [beg, end) and *end must be writable, the tokens are
+ * nul terminated in place. Returns the section subsequent values
+ * should be added to.
+ * ------------------------------------------------------------------------- */
+
+static inisec_t *
+inifile_parse_line(inifile_t *self, inisec_t *sec, char *beg, char *end)
+{
+  while( beg < end && xiswhite(*beg) ) ++beg;
+  while( end > beg && xiswhite(end[-1]) ) --end;
 
-  if( (file = fopen(path, "r")) == 0 )
+  if( beg == end || *beg == '#' )
   {
-    log_debug("%s: iniload/open: %s\n", path, strerror(errno));
-    goto cleanup;
+    return sec;
   }
 
-  while( getline(&data, &size, file) != -1 )
+  *end = 0;
+
+  if( *beg == BRA )
   {
-    char *pos = xstrip(data);
+    char *name = beg + 1;
+    char *ket  = memchr(name, KET, end - name);
 
-    if( *pos == 0 ) continue;
+    if( ket != 0 ) *ket = 0;
 
-    if( *pos == '#' ) continue;
+    return inifile_add_section(self, xstripall(name));
+  }
 
-    if( *pos == BRA )
-    {
-      char *name = xsplit(pos+1, 0, KET);
-      sec = inifile_add_section(self, xstripall(name));
-      continue;
-    }
+  char *key = beg;
+  char *val = memchr(beg, SEP, end - beg);
+
+  if( val != 0 )
+  {
+    *val++ = 0;
+    while( xiswhite(*val) ) ++val;
+  }
+  else
+  {
+    val = end;
+  }
 
-    key = xsplit(pos, &val, SEP);
-    xstripall(key);
-    xstrip(val);
+  xstripall(key);
 
-    if( sec && *key )
-    {
-      inisec_set(sec, key, val);
-    }
+  if( sec && *key )
+  {
+    inisec_append(sec, key, val);
   }
+  return sec;
+}
 
-  err = 0;
+/* ------------------------------------------------------------------------- *
+ * inifile_parse_bulk  --  tokenize ini file content in place
+ *
+ * The content is [data, data+size) and data[size] must be writable,
+ * so that also an unterminated last line can be terminated in place.
+ * Like inifile_load_bulk(), finish with inifile_reindex().
+ * ------------------------------------------------------------------------- */
 
-  cleanup:
+void
+inifile_parse_bulk(inifile_t *self, char *data, size_t size)
+{
+  inisec_t *sec = 0;
+  char     *pos = data;
+  char     *eof = data + size;
 
-  free(data);
+  while( pos < eof )
+  {
+    char *eol = memchr(pos, '\n', eof - pos) ?: eof;
 
-  if( file != 0 && fclose(file) == EOF )
+    sec = inifile_parse_line(self, sec, pos, eol);
+    pos = eol + 1;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * inifile_load_bulk  --  load values without resolving duplicate keys
+ *
+ * Several files can be loaded before calling inifile_reindex(),
+ * values from later files override the earlier ones.
+ *
+ * The file is read with one read() and tokenized in place, so the
+ * only copies made are the interned keys and values. Config files can
+ * be rewritten while we load them, so they are not mapped: truncation
+ * would raise SIGBUS instead of giving a short read.
+ * ------------------------------------------------------------------------- */
+
+int
+inifile_load_bulk(inifile_t *self, const char *path)
+{
+  char   *data = 0;
+  size_t  size = 0;
+
+  // zero padded -> data[size] is writable
+  if( xloadfile(path, &data, &size) == -1 )
   {
-    log_err("%s: iniload/close: %s\n", path, strerror(errno));
-    err = -1;
+    return -1;
   }
 
-  return err;
+  inifile_parse_bulk(self, data, size);
+  free(data);
+
+  return 0;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -829,13 +1036,16 @@ inifile_get_section_keys(const inifile_t *self, const char *sec_name,
 
   if( sec )
   {
+    void **tab = symtab_sorted(&sec->is_values);
+
     res = calloc(sec->is_values.st_count + 1, sizeof *res);
-    for( size_t i = 0; i < sec->is_values.st_count; ++i )
+    for( size_t i = 0; tab[i]; ++i )
     {
-      inival_t *val =  sec->is_values.st_elem[i];
+      inival_t *val = tab[i];
       res[cnt++] = strdup(val->iv_key);
     }
     res[cnt] = 0;
+    free(tab);
   }
 
   if( pcount ) *pcount = cnt;
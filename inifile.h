@@ -38,6 +38,8 @@
 
 # include "xutil.h"
 # include "symtab.h"
+# include "atom.h"
+# include "arena.h"
 
 # ifdef __cplusplus
 extern "C" {
@@ -62,8 +64,8 @@ typedef struct inival_t  inival_t;
 
 struct inival_t
 {
-  char *iv_key;
-  char *iv_val;
+  const char *iv_key; // atom
+  const char *iv_val; // atom
 };
 
 static inline const char *inival_get_key(const inival_t *self)
@@ -89,8 +91,9 @@ void      inival_delete_cb (void *self);
 
 struct inisec_t
 {
-  char      *is_name;
+  const char *is_name; // atom
   symtab_t   is_values;
+  arena_t   *is_arena; // values are allocated from arena, if set
 };
 
 void        inisec_ctor      (inisec_t *self);
@@ -101,6 +104,7 @@ int         inisec_compare   (const inisec_t *self, const char *name);
 int         inisec_compare_cb(const void *self, const void *name);
 void        inisec_delete_cb (void *self);
 void        inisec_set       (inisec_t *self, const char *key, const char *val);
+void        inisec_append    (inisec_t *self, const char *key, const char *val);
 const char *inisec_get       (inisec_t *self, const char *key, const char *val);
 int         inisec_has       (inisec_t *self, const char *key);
 void        inisec_del       (inisec_t *self, const char *key);
@@ -108,7 +112,7 @@ int         inisec_emit      (const inisec_t *self, FILE *file);
 
 static inline void inisec_set_name(inisec_t *self, const char *name)
 {
-  xstrset(&self->is_name, name);
+  atom_set(&self->is_name, name);
 }
 
 static inline const char *inisec_get_name(const inisec_t *self)
@@ -120,17 +124,25 @@ static inline const char *inisec_get_name(const inisec_t *self)
  * inifile_t
  * ------------------------------------------------------------------------- */
 
+/* An inifile_t constructed with inifile_ctor_arena() allocates its
+ * sections and values from an arena it owns. Removed entries are not
+ * reclaimed until the whole inifile_t is destroyed, so arena mode is
+ * meant for data that is loaded once and then used as is. */
+
 struct inifile_t
 {
   char      *if_path;
   symtab_t   if_sections;
+  arena_t   *if_arena; // owned, sections and values live here if set
 };
 
 const char * inifile_get_path         (inifile_t *self);
 void         inifile_set_path         (inifile_t *self, const char *path);
 void         inifile_ctor             (inifile_t *self);
+void         inifile_ctor_arena       (inifile_t *self);
 void         inifile_dtor             (inifile_t *self);
 inifile_t  * inifile_create           (void);
+inifile_t  * inifile_create_arena     (void);
 void         inifile_delete           (inifile_t *self);
 void         inifile_delete_cb        (void *self);
 int          inifile_has_section      (const inifile_t *self, const char *sec);
@@ -146,6 +158,10 @@ int          inifile_has              (inifile_t *self, const char *sec, const c
 int          inifile_emit             (const inifile_t *self, FILE *file);
 int          inifile_save             (const inifile_t *self, const char *path);
 int          inifile_load             (inifile_t *self, const char *path);
+int          inifile_load_bulk        (inifile_t *self, const char *path);
+void         inifile_parse_bulk       (inifile_t *self, char *data, size_t size);
+void         inifile_merge            (inifile_t *self, const inifile_t *layer);
+void         inifile_reindex          (inifile_t *self);
 int          inifile_save_to_memory   (const inifile_t *self, char **pdata, size_t *psize, const char *comment, size_t minsize);
 inisec_t   * inifile_scan_sections    (const inifile_t *self, int (*cb)(const inisec_t*, void*), void *aptr);
 inival_t   * inifile_scan_values      (const inifile_t *self, int (*cb)(const inisec_t *, const inival_t*, void*), void *aptr);
@@ -0,0 +1,443 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+
+#include "profiled_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+#include "logging.h"
+#include "xutil.h"
+
+/* ========================================================================= *
+ * File Format
+ * ========================================================================= */
+
+/* All integers are in host byte order.
+ *
+ *   head                      journal_head_t
+ *   records                   journal_rec_t + payload
+ *
+ * Record payload is "profile\0key\0value\0". Replay stops at the
+ * first record that is truncated or fails the checksum, i.e. a write
+ * interrupted by power loss costs only the changes in that write. */
+
+enum
+{
+  JOURNAL_MAGIC   = 0x4e524a50, // "PJRN"
+  JOURNAL_VERSION = 1,
+};
+
+typedef struct
+{
+  uint32_t jh_magic;
+  uint32_t jh_version;
+  uint32_t jh_base_size;  // size of the base file
+  uint32_t jh_base_check; // checksum of the base file content
+} journal_head_t;
+
+typedef struct
+{
+  uint32_t jr_size;       // payload size
+  uint32_t jr_check;      // checksum of payload
+} journal_rec_t;
+
+/* ------------------------------------------------------------------------- *
+ * journal_head  --  make journal header for given base file content
+ * ------------------------------------------------------------------------- */
+
+static
+void
+journal_head(journal_head_t *head, size_t base_size, uint32_t base_hash)
+{
+  head->jh_magic      = JOURNAL_MAGIC;
+  head->jh_version    = JOURNAL_VERSION;
+  head->jh_base_size  = base_size;
+  head->jh_base_check = base_hash;
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_next  --  skip nul terminated string within record payload
+ * ------------------------------------------------------------------------- */
+
+static
+const char *
+journal_next(const char *pos, const char *end)
+{
+  const char *eos = (pos && pos < end) ? memchr(pos, 0, end - pos) : 0;
+  return eos ? eos + 1 : 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_write_all  --  write buffer to file descriptor
+ * ------------------------------------------------------------------------- */
+
+static
+int
+journal_write_all(int file, const char *path, const void *data, size_t size)
+{
+  const char *base = data;
+  size_t      done = 0;
+
+  while( done < size )
+  {
+    errno = 0;
+    ssize_t n = TEMP_FAILURE_RETRY(write(file, base + done, size - done));
+    if( n <= 0 )
+    {
+      log_err("%s: journal/write: %s (%zd/%zd)\n", path, strerror(errno),
+              done, size);
+      return -1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
+/* ========================================================================= *
+ * journal_t  --  methods
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * journal_ctor
+ * ------------------------------------------------------------------------- */
+
+void
+journal_ctor(journal_t *self)
+{
+  self->jn_data  = 0;
+  self->jn_size  = 0;
+  self->jn_alloc = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_dtor
+ * ------------------------------------------------------------------------- */
+
+void
+journal_dtor(journal_t *self)
+{
+  free(self->jn_data);
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_create
+ * ------------------------------------------------------------------------- */
+
+journal_t *
+journal_create(void)
+{
+  journal_t *self = calloc(1, sizeof *self);
+  journal_ctor(self);
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_delete
+ * ------------------------------------------------------------------------- */
+
+void
+journal_delete(journal_t *self)
+{
+  if( self != 0 )
+  {
+    journal_dtor(self);
+    free(self);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_add  --  encode a value change record
+ * ------------------------------------------------------------------------- */
+
+void
+journal_add(journal_t *self, const char *prf, const char *key, const char *val)
+{
+  size_t        lp  = strlen(prf ?: "") + 1;
+  size_t        lk  = strlen(key ?: "") + 1;
+  size_t        lv  = strlen(val ?: "") + 1;
+  journal_rec_t rec = { .jr_size = lp + lk + lv };
+
+  size_t need = self->jn_size + sizeof rec + rec.jr_size;
+
+  if( need > self->jn_alloc )
+  {
+    self->jn_alloc = self->jn_alloc ? self->jn_alloc * 2 : 256;
+    while( self->jn_alloc < need ) self->jn_alloc *= 2;
+    self->jn_data = realloc(self->jn_data, self->jn_alloc);
+  }
+
+  char *pos = self->jn_data + self->jn_size + sizeof rec;
+  char *beg = pos;
+
+  memcpy(pos, prf ?: "", lp), pos += lp;
+  memcpy(pos, key ?: "", lk), pos += lk;
+  memcpy(pos, val ?: "", lv), pos += lv;
+
+  rec.jr_check = xhash(beg, rec.jr_size);
+  memcpy(self->jn_data + self->jn_size, &rec, sizeof rec);
+
+  self->jn_size = need;
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_steal  --  take ownership of encoded records
+ * ------------------------------------------------------------------------- */
+
+char *
+journal_steal(journal_t *self, size_t *psize)
+{
+  char *res = self->jn_data;
+
+  *psize = self->jn_size;
+
+  self->jn_data  = 0;
+  self->jn_size  = 0;
+  self->jn_alloc = 0;
+
+  return res;
+}
+
+/* ========================================================================= *
+ * Journal File
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * journal_append  --  append encoded records to journal file
+ *
+ * A new journal file gets a header describing the current content of
+ * the base file. The records are written with one write and synced
+ * with one fdatasync, size of the journal after the write is returned
+ * via pend. When the header is written, also the directory is synced
+ * so that the file itself survives power loss.
+ * ------------------------------------------------------------------------- */
+
+int
+journal_append(const char *path, size_t base_size, uint32_t base_hash,
+               const void *data, size_t size, size_t *pend)
+{
+  int   err  = -1;
+  int   file = -1;
+  int   head = 0;
+  char *dir  = 0;
+
+  struct stat st;
+
+  if( (file = open(path, O_WRONLY|O_CREAT|O_APPEND, 0666)) == -1 )
+  {
+    log_err("%s: journal/open: %s\n", path, strerror(errno));
+    goto cleanup;
+  }
+
+  if( fstat(file, &st) == -1 )
+  {
+    log_err("%s: journal/stat: %s\n", path, strerror(errno));
+    goto cleanup;
+  }
+
+  if( (size_t)st.st_size < sizeof(journal_head_t) )
+  {
+    // new journal, or header write was interrupted
+    journal_head_t jh;
+    journal_head(&jh, base_size, base_hash);
+
+    if( ftruncate(file, 0) == -1 )
+    {
+      log_err("%s: journal/truncate: %s\n", path, strerror(errno));
+      goto cleanup;
+    }
+    if( journal_write_all(file, path, &jh, sizeof jh) == -1 )
+    {
+      goto cleanup;
+    }
+    head = 1;
+  }
+
+  if( journal_write_all(file, path, data, size) == -1 )
+  {
+    goto cleanup;
+  }
+
+  if( fdatasync(file) == -1 )
+  {
+    log_err("%s: journal/fdatasync: %s\n", path, strerror(errno));
+    goto cleanup;
+  }
+
+  // the file may have been created just now
+  if( head && xsyncdir(dir = xdirname(path)) == -1 )
+  {
+    goto cleanup;
+  }
+
+  if( fstat(file, &st) == -1 )
+  {
+    log_err("%s: journal/stat: %s\n", path, strerror(errno));
+    goto cleanup;
+  }
+
+  *pend = st.st_size;
+
+  err = 0;
+
+  cleanup:
+
+  if( file != -1 && close(file) == -1 )
+  {
+    log_err("%s: journal/close: %s\n", path, strerror(errno));
+    err = -1;
+  }
+
+  free(dir);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * journal_replay  --  apply journal file records to inifile
+ *
+ * Journals made for some other base file content are removed, damaged
+ * tail is truncated away so that further appends are replayable.
+ * Returns number of records applied, size of the valid part of the
+ * journal is returned via pend.
+ * ------------------------------------------------------------------------- */
+
+int
+journal_replay(const char *path, size_t base_size, uint32_t base_hash,
+               inifile_t *ini, size_t *pend)
+{
+  int     cnt  = 0;
+  char   *data = 0;
+  size_t  size = 0;
+  size_t  pos  = 0;
+
+  journal_head_t head, want;
+
+  if( xloadfile(path, &data, &size) == -1 || size == 0 )
+  {
+    goto cleanup;
+  }
+
+  if( size < sizeof head )
+  {
+    log_warning("%s: truncated journal header\n", path);
+    remove(path);
+    goto cleanup;
+  }
+
+  memcpy(&head, data, sizeof head);
+  journal_head(&want, base_size, base_hash);
+
+  if( head.jh_magic != want.jh_magic || head.jh_version != want.jh_version )
+  {
+    log_warning("%s: not a valid journal\n", path);
+    remove(path);
+    goto cleanup;
+  }
+
+  if( head.jh_base_size  != want.jh_base_size ||
+      head.jh_base_check != want.jh_base_check )
+  {
+    // compaction was interrupted after the base file was replaced
+    log_notice("%s: journal does not match base file, ignored\n", path);
+    remove(path);
+    goto cleanup;
+  }
+
+  pos = sizeof head;
+
+  for( ;; )
+  {
+    journal_rec_t rec;
+
+    if( size - pos < sizeof rec )
+    {
+      break;
+    }
+
+    memcpy(&rec, data + pos, sizeof rec);
+
+    if( rec.jr_size > size - pos - sizeof rec )
+    {
+      break;
+    }
+
+    const char *prf = data + pos + sizeof rec;
+    const char *end = prf + rec.jr_size;
+
+    if( rec.jr_check != xhash(prf, rec.jr_size) )
+    {
+      break;
+    }
+
+    const char *key = journal_next(prf, end);
+    const char *val = journal_next(key, end);
+
+    if( journal_next(val, end) != end )
+    {
+      break;
+    }
+
+    inifile_set(ini, prf, key, val);
+
+    ++cnt;
+    pos += sizeof rec + rec.jr_size;
+  }
+
+  if( pos != size )
+  {
+    log_warning("%s: dropping %zd bytes of damaged journal\n",
+                path, size - pos);
+    if( truncate(path, pos) == -1 )
+    {
+      log_err("%s: journal/truncate: %s\n", path, strerror(errno));
+      remove(path);
+      pos = 0;
+    }
+  }
+
+  cleanup:
+
+  *pend = pos;
+
+  free(data);
+
+  return cnt;
+}
@@ -0,0 +1,93 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+
+#ifndef JOURNAL_H_
+# define JOURNAL_H_
+
+# include <stddef.h>
+# include <stdint.h>
+
+# include "inifile.h"
+
+# ifdef __cplusplus
+extern "C" {
+# elif 0
+} /* fool JED indentation ... */
+# endif
+
+typedef struct journal_t journal_t;
+
+/* ------------------------------------------------------------------------- *
+ * journal_t
+ * ------------------------------------------------------------------------- */
+
+/* Append-only log of custom value changes.
+ *
+ * Changes are collected to journal_t as encoded records, which are
+ * then appended to the journal file as one write followed by one
+ * fdatasync. The journal file starts with a header that identifies
+ * the content of the base file it applies to, so that a journal left
+ * behind by an interrupted compaction is not applied on top of the
+ * already compacted base file.
+ *
+ * journal_append() and journal_replay() do not touch shared state
+ * and can be used from any thread. */
+
+struct journal_t
+{
+  char   *jn_data;  // encoded records
+  size_t  jn_size;
+  size_t  jn_alloc;
+};
+
+void       journal_ctor  (journal_t *self);
+void       journal_dtor  (journal_t *self);
+journal_t *journal_create(void);
+void       journal_delete(journal_t *self);
+void       journal_add   (journal_t *self, const char *prf,
+                          const char *key, const char *val);
+char      *journal_steal (journal_t *self, size_t *psize);
+
+int        journal_append(const char *path, size_t base_size,
+                          uint32_t base_hash, const void *data,
+                          size_t size, size_t *pend);
+int        journal_replay(const char *path, size_t base_size,
+                          uint32_t base_hash, inifile_t *ini,
+                          size_t *pend);
+
+# ifdef __cplusplus
+};
+# endif
+
+#endif /* JOURNAL_H_ */
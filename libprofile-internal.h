@@ -46,8 +46,31 @@ extern "C" {
 } /* fool JED indentation ... */
 #endif
 
+/* Value in the forms returned by profile_parse_xxx() functions */
+typedef struct
+{
+  int    tv_bool;
+  int    tv_int;
+  double tv_dbl;
+} profiletyped_t;
+
 void profile_tracker_disconnect(void);
 void profile_tracker_reconnect(void);
+int  profile_tracker_is_connected(void);
+
+DBusConnection *profile_connection_get_direct(void);
+
+void          profile_cache_flush(void);
+const char   *profile_cache_get_profile(void);
+const char   *profile_cache_get_value(const char *profile, const char *key);
+const profiletyped_t *profile_cache_get_typed(const char *profile, const char *key);
+profileval_t *profile_cache_get_values(const char *profile);
+char         *profile_cache_resolve(const char *profile);
+void          profile_cache_set_active(const char *profile);
+void          profile_cache_set_value(const char *profile, const char *key,
+                                      const char *val, const char *type);
+void          profile_cache_forget_active(void);
+void          profile_cache_forget_value(const char *profile, const char *key);
 
 #ifdef __cplusplus
 };
@@ -44,6 +44,9 @@
 #include "xutil.h"
 #include "libprofile-internal.h"
 #include "profile_dbus.h"
+#include "codec.h"
+
+#include "dbus-gmain/dbus-gmain.h"
 
 static inline void client_check_profile(const char **pprofile)
 {
@@ -108,12 +111,32 @@ client_exec_method_call(DBusMessage *msg)
   DBusMessage    *rsp  = 0;
   DBusError       err  = DBUS_ERROR_INIT;
 
-  if( (conn = profile_connection_get()) == 0 )
+  if( (conn = profile_connection_get_direct()) == 0 )
   {
     goto cleanup;
   }
 
-  if( !(rsp = dbus_connection_send_with_reply_and_block(conn, msg, -1, &err)) )
+  rsp = dbus_connection_send_with_reply_and_block(conn, msg, -1, &err);
+
+  if( rsp == 0 && !dbus_connection_get_is_connected(conn) )
+  {
+    // peer-to-peer connection lost, e.g. profiled was restarted
+    // -> retry once via bus or the new peer-to-peer connection
+    DBusMessage *again = dbus_message_copy(msg);
+
+    dbus_connection_unref(conn), conn = 0;
+    dbus_error_free(&err);
+
+    // the copy does not have the serial number used above
+    if( again != 0 && (conn = profile_connection_get_direct()) != 0 )
+    {
+      rsp = dbus_connection_send_with_reply_and_block(conn, again, -1, &err);
+    }
+
+    if( again != 0 ) dbus_message_unref(again);
+  }
+
+  if( rsp == 0 )
   {
     log_err_F("%s: %s: %s\n", "dbus_connection_send_with_reply_and_block", err.name, err.message);
     goto cleanup;
@@ -240,330 +263,485 @@ profile_free_keys(char **v)
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_get_values  --  handle PROFILED_GET_VALUES method call
+ * client_decode_values  --  decode a(sss) array into profileval_t vector
  * ------------------------------------------------------------------------- */
 
+static
 profileval_t *
-profile_get_values(const char *profile)
+client_decode_values(DBusMessageIter *iter)
 {
-  profileval_t     *res = 0;
+  profileval_t *res = 0;
   int           cnt = 0;
   int           top = 0;
-  DBusMessage  *msg = 0;
-  DBusMessage  *rsp = 0;
 
-  client_check_profile(&profile);
+  DBusMessageIter item, memb;
 
-  if( (msg = client_make_method_message(PROFILED_GET_VALUES,
-                                        DBUS_TYPE_STRING, &profile,
-                                        DBUS_TYPE_INVALID)) )
+  if( iter != 0 && dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_ARRAY )
   {
-    if( (rsp = client_exec_method_call(msg)) )
-    {
-      // FIXME: quick and dirty struct array decoding
-
-      DBusMessageIter iter, item, memb;
-
-      dbus_message_iter_init(rsp, &iter);
+    dbus_message_iter_recurse(iter, &item);
 
-      if( dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY )
-      {
-        dbus_message_iter_recurse(&iter, &item);
-
-        top = 16;
-        res = malloc(top * sizeof *res);
-
-        while( dbus_message_iter_get_arg_type(&item) == DBUS_TYPE_STRUCT )
-        {
-          dbus_message_iter_recurse(&item, &memb);
+    top = 16;
+    res = malloc(top * sizeof *res);
 
-          char *k = 0, *v = 0, *t = 0;
-          dbus_message_iter_get_basic(&memb, &k);
-          dbus_message_iter_next(&memb);
+    while( dbus_message_iter_get_arg_type(&item) == DBUS_TYPE_STRUCT )
+    {
+      dbus_message_iter_recurse(&item, &memb);
 
-          dbus_message_iter_get_basic(&memb, &v);
-          dbus_message_iter_next(&memb);
+      char *k = 0, *v = 0, *t = 0;
+      dbus_message_iter_get_basic(&memb, &k);
+      dbus_message_iter_next(&memb);
 
-          dbus_message_iter_get_basic(&memb, &t);
-          dbus_message_iter_next(&memb);
+      dbus_message_iter_get_basic(&memb, &v);
+      dbus_message_iter_next(&memb);
 
-          if( cnt == top )
-          {
-            res = realloc(res, (top *= 2) * sizeof *res);
-          }
+      dbus_message_iter_get_basic(&memb, &t);
+      dbus_message_iter_next(&memb);
 
-          profileval_ctor_ex(&res[cnt++], k, v, t);
-          dbus_message_iter_next(&item);
-        }
+      if( cnt == top )
+      {
+        res = realloc(res, (top *= 2) * sizeof *res);
       }
+
+      profileval_ctor_ex(&res[cnt++], k, v, t);
+      dbus_message_iter_next(&item);
     }
   }
 
   res = realloc(res, (cnt+1) * sizeof *res);
   profileval_ctor(&res[cnt]);
 
-  if( rsp != 0 ) dbus_message_unref(rsp);
-  if( msg != 0 ) dbus_message_unref(msg);
-
   return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_free_values
+ * client_request_t  --  state of asynchronous method call
+ * ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  void                      *rq_cb;    // reply callback
+  void                      *rq_data;  // user data for callback
+  profile_user_data_free_fn  rq_free;  // user data free function
+} client_request_t;
+
+/* ------------------------------------------------------------------------- *
+ * client_request_create
+ * ------------------------------------------------------------------------- */
+
+static
+client_request_t *
+client_request_create(void *cb, void *data, profile_user_data_free_fn free_cb)
+{
+  client_request_t *self = calloc(1, sizeof *self);
+
+  if( self != 0 )
+  {
+    self->rq_cb   = cb;
+    self->rq_data = data;
+    self->rq_free = free_cb;
+  }
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * client_request_delete_cb  --  called by dbus when pending call is done
  * ------------------------------------------------------------------------- */
 
+static
 void
-profile_free_values(profileval_t *values)
+client_request_delete_cb(void *aptr)
 {
-  profileval_free_vector(values);
+  client_request_t *self = aptr;
+
+  if( self != 0 )
+  {
+    if( self->rq_free != 0 && self->rq_data != 0 )
+    {
+      self->rq_free(self->rq_data);
+    }
+    free(self);
+  }
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_has_profile  --  handle PROFILED_HAS_PROFILE method call
+ * client_send_method_call  --  send method call, reply to notify function
+ *
+ * On success the request is owned by the pending call, on failure the
+ * request is deleted without calling the user data free function.
  * ------------------------------------------------------------------------- */
 
+static
 int
-profile_has_profile(const char *profile)
+client_send_method_call(DBusMessage *msg,
+                        DBusPendingCallNotifyFunction notify,
+                        client_request_t *req)
 {
-  int           res = 0;
-  DBusMessage  *msg = 0;
-  DBusMessage  *rsp = 0;
-  DBusError    err  = DBUS_ERROR_INIT;
+  int              res  = -1;
+  DBusConnection  *conn = 0;
+  DBusPendingCall *pc   = 0;
 
-  client_check_profile(&profile);
+  if( msg == 0 || req == 0 )
+  {
+    goto cleanup;
+  }
 
-  if( (msg = client_make_method_message(PROFILED_HAS_PROFILE,
-                                        DBUS_TYPE_STRING, &profile,
-                                        DBUS_TYPE_INVALID)) )
+  if( (conn = profile_connection_get_direct()) == 0 )
   {
-    if( (rsp = client_exec_method_call(msg)) )
-    {
-      dbus_bool_t v = 0;
+    goto cleanup;
+  }
 
-      if( dbus_message_get_args(rsp, &err,
-                                DBUS_TYPE_BOOLEAN, &v,
-                                DBUS_TYPE_INVALID) )
-      {
-        if( v != 0 ) res = 1;
-      }
-    }
+  /* replies are handled when the connection is dispatched */
+  dbus_gmain_set_up_connection(conn, NULL);
+
+  if( !dbus_connection_send_with_reply(conn, msg, &pc,
+                                       DBUS_TIMEOUT_USE_DEFAULT) || !pc )
+  {
+    log_err_F("%s: %s\n", dbus_message_get_member(msg),
+              "dbus_connection_send_with_reply failed");
+    goto cleanup;
   }
 
-  if( rsp != 0 ) dbus_message_unref(rsp);
-  if( msg != 0 ) dbus_message_unref(msg);
+  if( !dbus_pending_call_set_notify(pc, notify, req,
+                                    client_request_delete_cb) )
+  {
+    dbus_pending_call_cancel(pc);
+    goto cleanup;
+  }
 
-  dbus_error_free(&err);
+  req = 0, res = 0;
+
+  cleanup:
+
+  if( req  != 0 ) req->rq_free = 0, client_request_delete_cb(req);
+  if( pc   != 0 ) dbus_pending_call_unref(pc);
+  if( conn != 0 ) dbus_connection_unref(conn);
 
   return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_get_profile  --  handle PROFILED_GET_PROFILE method call
+ * client_steal_reply  --  get reply message from completed pending call
  * ------------------------------------------------------------------------- */
 
-char *
-profile_get_profile(void)
+static
+DBusMessage *
+client_steal_reply(DBusPendingCall *pc)
 {
-  char         *res = 0;
-  DBusMessage  *msg = 0;
-  DBusMessage  *rsp = 0;
-  DBusError    err  = DBUS_ERROR_INIT;
+  DBusMessage *rsp = dbus_pending_call_steal_reply(pc);
+  DBusError    err = DBUS_ERROR_INIT;
 
-  if( (msg = client_make_method_message(PROFILED_GET_PROFILE,
-                                        DBUS_TYPE_INVALID)) )
+  if( rsp != 0 && dbus_set_error_from_message(&err, rsp) )
   {
-    if( (rsp = client_exec_method_call(msg)) )
-    {
-      char *v = 0;
-      if( dbus_message_get_args(rsp, &err,
-                                DBUS_TYPE_STRING, &v,
-                                DBUS_TYPE_INVALID) )
-      {
-        res = strdup(v ?: "");
-      }
-    }
+    log_err_F("%s: %s\n", err.name, err.message);
+    dbus_message_unref(rsp), rsp = 0;
   }
 
-  if( rsp != 0 ) dbus_message_unref(rsp);
-  if( msg != 0 ) dbus_message_unref(msg);
-
   dbus_error_free(&err);
 
-  return res;
+  return rsp;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_set_profile  --  handle PROFILED_SET_PROFILE method call
+ * client_reply_value_cb  --  pass string reply to callback
  * ------------------------------------------------------------------------- */
 
-int
-profile_set_profile(const char *profile)
+static
+void
+client_reply_value_cb(DBusPendingCall *pc, void *aptr)
 {
-  int           res = -1;
-  DBusMessage  *msg = 0;
-  DBusMessage  *rsp = 0;
-  DBusError    err  = DBUS_ERROR_INIT;
-
-  client_check_profile(&profile);
-
-  if( (msg = client_make_method_message(PROFILED_SET_PROFILE,
-                                        DBUS_TYPE_STRING, &profile,
-                                        DBUS_TYPE_INVALID)) )
+  client_request_t       *req = aptr;
+  profile_reply_value_fn  cb  = req->rq_cb;
+  DBusMessage            *rsp = client_steal_reply(pc);
+  DBusError               err = DBUS_ERROR_INIT;
+  const char             *res = 0;
+  char                   *v   = 0;
+
+  if( rsp != 0 && dbus_message_get_args(rsp, &err,
+                                        DBUS_TYPE_STRING, &v,
+                                        DBUS_TYPE_INVALID) )
   {
-    if( (rsp = client_exec_method_call(msg)) )
-    {
-      dbus_bool_t v = 0;
-
-      if( dbus_message_get_args(rsp, &err,
-                                DBUS_TYPE_BOOLEAN, &v,
-                                DBUS_TYPE_INVALID) )
-      {
-        if( v != 0 ) res = 0;
-      }
-    }
+    res = v ?: "";
   }
 
+  if( cb != 0 ) cb(res, req->rq_data);
+
   if( rsp != 0 ) dbus_message_unref(rsp);
-  if( msg != 0 ) dbus_message_unref(msg);
 
   dbus_error_free(&err);
-
-  return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_has_value  --  handle PROFILED_HAS_VALUE method call
+ * client_reply_status_cb  --  pass boolean reply to callback as status
  * ------------------------------------------------------------------------- */
 
-int
-profile_has_value(const char *key)
+static
+void
+client_reply_status_cb(DBusPendingCall *pc, void *aptr)
 {
-  int           res = 0;
-  DBusMessage  *msg = 0;
-  DBusMessage  *rsp = 0;
-  DBusError    err  = DBUS_ERROR_INIT;
-
-  if( (msg = client_make_method_message(PROFILED_HAS_VALUE,
-                                        DBUS_TYPE_STRING, &key,
-                                        DBUS_TYPE_INVALID)) )
+  client_request_t        *req = aptr;
+  profile_reply_status_fn  cb  = req->rq_cb;
+  DBusMessage             *rsp = client_steal_reply(pc);
+  DBusError                err = DBUS_ERROR_INIT;
+  int                      res = -1;
+  dbus_bool_t              v   = 0;
+
+  if( rsp != 0 && dbus_message_get_args(rsp, &err,
+                                        DBUS_TYPE_BOOLEAN, &v,
+                                        DBUS_TYPE_INVALID) )
   {
-    if( (rsp = client_exec_method_call(msg)) )
-    {
-      dbus_bool_t v = 0;
-
-      if( dbus_message_get_args(rsp, &err,
-                                DBUS_TYPE_BOOLEAN, &v,
-                                DBUS_TYPE_INVALID) )
-      {
-        if( v != 0 ) res = 1;
-      }
-    }
+    if( v != 0 ) res = 0;
   }
 
+  if( cb != 0 ) cb(res, req->rq_data);
+
   if( rsp != 0 ) dbus_message_unref(rsp);
-  if( msg != 0 ) dbus_message_unref(msg);
 
   dbus_error_free(&err);
-
-  return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_is_writable  --  handle PROFILED_IS_WRITABLE method call
+ * client_reply_values_cb  --  pass values array reply to callback
  * ------------------------------------------------------------------------- */
 
-int
-profile_is_writable(const char *key)
+static
+void
+client_reply_values_cb(DBusPendingCall *pc, void *aptr)
 {
-  int           res = 0;
-  DBusMessage  *msg = 0;
-  DBusMessage  *rsp = 0;
-  DBusError    err  = DBUS_ERROR_INIT;
+  client_request_t        *req = aptr;
+  profile_reply_values_fn  cb  = req->rq_cb;
+  DBusMessage             *rsp = client_steal_reply(pc);
+  profileval_t            *res = 0;
 
-  if( (msg = client_make_method_message(PROFILED_IS_WRITABLE,
-                                        DBUS_TYPE_STRING, &key,
-                                        DBUS_TYPE_INVALID)) )
+  if( rsp != 0 )
   {
-    if( (rsp = client_exec_method_call(msg)) )
-    {
-      dbus_bool_t v = 0;
+    DBusMessageIter iter;
 
-      if( dbus_message_get_args(rsp, &err,
-                                DBUS_TYPE_BOOLEAN, &v,
-                                DBUS_TYPE_INVALID) )
-      {
-        if( v != 0 ) res = 1;
-      }
-    }
+    dbus_message_iter_init(rsp, &iter);
+    res = client_decode_values(&iter);
   }
 
-  if( rsp != 0 ) dbus_message_unref(rsp);
-  if( msg != 0 ) dbus_message_unref(msg);
+  if( cb != 0 ) cb(res, req->rq_data);
 
-  dbus_error_free(&err);
+  profileval_free_vector(res);
 
-  return res;
+  if( rsp != 0 ) dbus_message_unref(rsp);
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_get_value  --  handle PROFILED_GET_VALUE method call
+ * profile_get_values  --  handle PROFILED_GET_VALUES method call
  * ------------------------------------------------------------------------- */
 
-char *
-profile_get_value(const char *profile, const char *key)
+profileval_t *
+profile_get_values(const char *profile)
 {
-  char         *res = 0;
-  DBusMessage  *msg = 0;
-  DBusMessage  *rsp = 0;
-  DBusError    err  = DBUS_ERROR_INIT;
+  profileval_t *res  = 0;
+  DBusMessage  *msg  = 0;
+  DBusMessage  *rsp  = 0;
+  char         *name = 0;
 
   client_check_profile(&profile);
 
-  if( (msg = client_make_method_message(PROFILED_GET_VALUE,
+  if( (res = profile_cache_get_values(profile)) != 0 )
+  {
+    goto cleanup;
+  }
+
+  // ask for the cached profile by name so that the reply can be cached
+  if( (name = profile_cache_resolve(profile)) != 0 )
+  {
+    profile = name;
+  }
+
+  if( (msg = client_make_method_message(PROFILED_GET_VALUES,
                                         DBUS_TYPE_STRING, &profile,
-                                        DBUS_TYPE_STRING, &key,
                                         DBUS_TYPE_INVALID)) )
   {
     if( (rsp = client_exec_method_call(msg)) )
     {
-      char *v = 0;
-      if( dbus_message_get_args(rsp, &err,
-                                DBUS_TYPE_STRING, &v,
-                                DBUS_TYPE_INVALID) )
-      {
-        res = strdup(v ?: "");
-      }
+      DBusMessageIter iter;
+
+      dbus_message_iter_init(rsp, &iter);
+      res = client_decode_values(&iter);
     }
   }
 
+  for( size_t i = 0; name && res && res[i].pv_key; ++i )
+  {
+    profile_cache_set_value(name, res[i].pv_key, res[i].pv_val, 0);
+  }
+
+  if( res == 0 )
+  {
+    res = client_decode_values(0);
+  }
+
+  cleanup:
+
   if( rsp != 0 ) dbus_message_unref(rsp);
   if( msg != 0 ) dbus_message_unref(msg);
 
-  dbus_error_free(&err);
-
-  log_debug_F("%s(%s) = %s\n", key, profile, res);
+  free(name);
 
   return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_set_value  --  handle PROFILED_SET_VALUE method call
+ * profile_free_values
  * ------------------------------------------------------------------------- */
 
-int
-profile_set_value(const char *profile, const char *key, const char *val)
+void
+profile_free_values(profileval_t *values)
 {
-  int           res = -1;
-  DBusMessage  *msg = 0;
+  profileval_free_vector(values);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_all  --  handle PROFILED_GET_ALL method call
+ * ------------------------------------------------------------------------- */
+
+profileall_t *
+profile_get_all(void)
+{
+  profileall_t *res = 0;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  int           cnt = 0;
+  int           top = 0;
+
+  DBusMessageIter iter, item, memb;
+
+  if( !(msg = client_make_method_message(PROFILED_GET_ALL,
+                                         DBUS_TYPE_INVALID)) )
+  {
+    goto cleanup;
+  }
+
+  if( !(rsp = client_exec_method_call(msg)) )
+  {
+    goto cleanup;
+  }
+
+  if( dbus_message_get_type(rsp) != DBUS_MESSAGE_TYPE_METHOD_RETURN )
+  {
+    goto cleanup;
+  }
+
+  res = calloc(1, sizeof *res);
+
+  dbus_message_iter_init(rsp, &iter);
+
+  /* active profile */
+  if( dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_STRING )
+  {
+    const char *s = 0;
+    dbus_message_iter_get_basic(&iter, &s);
+    res->pa_active = strdup(s);
+  }
+  dbus_message_iter_next(&iter);
+
+  /* available profiles */
+  top = 16;
+  res->pa_profiles = malloc(top * sizeof *res->pa_profiles);
+
+  if( dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY )
+  {
+    dbus_message_iter_recurse(&iter, &item);
+
+    while( dbus_message_iter_get_arg_type(&item) == DBUS_TYPE_STRING )
+    {
+      const char *s = 0;
+      dbus_message_iter_get_basic(&item, &s);
+
+      if( cnt + 1 >= top )
+      {
+        res->pa_profiles = realloc(res->pa_profiles,
+                                   (top *= 2) * sizeof *res->pa_profiles);
+      }
+      res->pa_profiles[cnt++] = strdup(s);
+      dbus_message_iter_next(&item);
+    }
+  }
+  dbus_message_iter_next(&iter);
+
+  res->pa_profiles[cnt] = 0;
+
+  /* values of each profile, in the same order as profile names */
+  res->pa_values = calloc(cnt + 1, sizeof *res->pa_values);
+
+  if( dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY )
+  {
+    dbus_message_iter_recurse(&iter, &item);
+
+    for( int i = 0; i < cnt; ++i )
+    {
+      if( dbus_message_iter_get_arg_type(&item) != DBUS_TYPE_STRUCT )
+      {
+        break;
+      }
+
+      dbus_message_iter_recurse(&item, &memb);
+      dbus_message_iter_next(&memb);
+
+      res->pa_values[i] = client_decode_values(&memb);
+      dbus_message_iter_next(&item);
+    }
+  }
+
+  for( int i = 0; i < cnt; ++i )
+  {
+    if( res->pa_values[i] == 0 )
+    {
+      res->pa_values[i] = client_decode_values(0);
+    }
+  }
+
+  cleanup:
+
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_free_all
+ * ------------------------------------------------------------------------- */
+
+void
+profile_free_all(profileall_t *all)
+{
+  if( all != 0 )
+  {
+    if( all->pa_values != 0 )
+    {
+      for( size_t i = 0; all->pa_values[i]; ++i )
+      {
+        profileval_free_vector(all->pa_values[i]);
+      }
+      free(all->pa_values);
+    }
+    xfreev(all->pa_profiles);
+    free(all->pa_active);
+    free(all);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_has_profile  --  handle PROFILED_HAS_PROFILE method call
+ * ------------------------------------------------------------------------- */
+
+int
+profile_has_profile(const char *profile)
+{
+  int           res = 0;
+  DBusMessage  *msg = 0;
   DBusMessage  *rsp = 0;
   DBusError    err  = DBUS_ERROR_INIT;
 
   client_check_profile(&profile);
 
-  if( (msg = client_make_method_message(PROFILED_SET_VALUE,
+  if( (msg = client_make_method_message(PROFILED_HAS_PROFILE,
                                         DBUS_TYPE_STRING, &profile,
-                                        DBUS_TYPE_STRING, &key,
-                                        DBUS_TYPE_STRING, &val,
                                         DBUS_TYPE_INVALID)) )
   {
     if( (rsp = client_exec_method_call(msg)) )
@@ -574,7 +752,7 @@ profile_set_value(const char *profile, const char *key, const char *val)
                                 DBUS_TYPE_BOOLEAN, &v,
                                 DBUS_TYPE_INVALID) )
       {
-        if( v != 0 ) res = 0;
+        if( v != 0 ) res = 1;
       }
     }
   }
@@ -588,20 +766,24 @@ profile_set_value(const char *profile, const char *key, const char *val)
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_get_type  --  handle PROFILED_GET_TYPE method call
+ * profile_get_profile  --  handle PROFILED_GET_PROFILE method call
  * ------------------------------------------------------------------------- */
 
 char *
-profile_get_type(const char *key)
+profile_get_profile(void)
 {
   char         *res = 0;
   DBusMessage  *msg = 0;
   DBusMessage  *rsp = 0;
   DBusError    err  = DBUS_ERROR_INIT;
+  const char  *hit  = profile_cache_get_profile();
 
-  if( (msg = client_make_method_message(PROFILED_GET_TYPE,
-                                        DBUS_TYPE_STRING, &key,
-                                        DBUS_TYPE_INVALID)) )
+  if( hit != 0 )
+  {
+    res = strdup(hit);
+  }
+  else if( (msg = client_make_method_message(PROFILED_GET_PROFILE,
+                                             DBUS_TYPE_INVALID)) )
   {
     if( (rsp = client_exec_method_call(msg)) )
     {
@@ -611,6 +793,7 @@ profile_get_type(const char *key)
                                 DBUS_TYPE_INVALID) )
       {
         res = strdup(v ?: "");
+        profile_cache_set_active(res);
       }
     }
   }
@@ -624,127 +807,917 @@ profile_get_type(const char *key)
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_parse_bool
+ * profile_set_profile  --  handle PROFILED_SET_PROFILE method call
  * ------------------------------------------------------------------------- */
 
 int
-profile_parse_bool(const char *text)
+profile_set_profile(const char *profile)
 {
-  if( text != 0 )
+  int           res = -1;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  DBusError    err  = DBUS_ERROR_INIT;
+
+  client_check_profile(&profile);
+
+  profile_cache_forget_active();
+
+  if( (msg = client_make_method_message(PROFILED_SET_PROFILE,
+                                        DBUS_TYPE_STRING, &profile,
+                                        DBUS_TYPE_INVALID)) )
   {
-    for( size_t i = 0; profile_bool_true_values[i]; ++i )
+    if( (rsp = client_exec_method_call(msg)) )
     {
-      if( !strcasecmp(profile_bool_true_values[i], text) )
-      {
-        return 1;
-      }
-    }
+      dbus_bool_t v = 0;
 
-    for( size_t i = 0; profile_bool_false_values[i]; ++i )
-    {
-      if( !strcasecmp(profile_bool_false_values[i], text) )
+      if( dbus_message_get_args(rsp, &err,
+                                DBUS_TYPE_BOOLEAN, &v,
+                                DBUS_TYPE_INVALID) )
       {
-        return 0;
+        if( v != 0 ) res = 0;
       }
     }
-    return strtol(text, 0, 0) != 0;
   }
 
-  return 0;
-}
-
-/* ------------------------------------------------------------------------- *
- * profile_parse_int
- * ------------------------------------------------------------------------- */
-
-int
-profile_parse_int(const char *text)
-{
-  return text ? strtol(text, 0, 0) : 0;
-}
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
 
-/* ------------------------------------------------------------------------- *
- * profile_parse_double
- * ------------------------------------------------------------------------- */
+  dbus_error_free(&err);
 
-double
-profile_parse_double(const char *text)
-{
-  return text ? strtod(text, 0) : 0;
+  return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_get_value_as_bool
+ * profile_has_value  --  handle PROFILED_HAS_VALUE method call
  * ------------------------------------------------------------------------- */
 
 int
-profile_get_value_as_bool(const char *profile, const char *key)
+profile_has_value(const char *key)
 {
-  char *val = profile_get_value(profile, key);
-  int   res = profile_parse_bool(val);
-  free(val);
-  return res;
-}
+  int           res = 0;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  DBusError    err  = DBUS_ERROR_INIT;
 
-/* ------------------------------------------------------------------------- *
- * profile_set_value_as_bool
- * ------------------------------------------------------------------------- */
+  if( (msg = client_make_method_message(PROFILED_HAS_VALUE,
+                                        DBUS_TYPE_STRING, &key,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    if( (rsp = client_exec_method_call(msg)) )
+    {
+      dbus_bool_t v = 0;
 
-int
-profile_set_value_as_bool(const char *profile, const char *key, int val)
-{
-  return profile_set_value(profile, key, val ?
-                           *profile_bool_true_values :
-                           *profile_bool_false_values);
+      if( dbus_message_get_args(rsp, &err,
+                                DBUS_TYPE_BOOLEAN, &v,
+                                DBUS_TYPE_INVALID) )
+      {
+        if( v != 0 ) res = 1;
+      }
+    }
+  }
 
-}
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
 
-/* ------------------------------------------------------------------------- *
- * profile_get_value_as_int  --
- * ------------------------------------------------------------------------- */
+  dbus_error_free(&err);
 
-int
-profile_get_value_as_int(const char *profile, const char *key)
-{
-  char *val = profile_get_value(profile, key);
-  int   res = profile_parse_int(val);
-  free(val);
   return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_set_value_as_int  --
+ * profile_is_writable  --  handle PROFILED_IS_WRITABLE method call
  * ------------------------------------------------------------------------- */
 
 int
-profile_set_value_as_int(const char *profile, const char *key, int val)
+profile_is_writable(const char *key)
 {
-  char tmp[32];
-  snprintf(tmp, sizeof tmp, "%d", val);
-  return profile_set_value(profile, key, tmp);
-}
+  int           res = 0;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  DBusError    err  = DBUS_ERROR_INIT;
 
-/* ------------------------------------------------------------------------- *
- * profile_get_value_as_double  --
- * ------------------------------------------------------------------------- */
+  if( (msg = client_make_method_message(PROFILED_IS_WRITABLE,
+                                        DBUS_TYPE_STRING, &key,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    if( (rsp = client_exec_method_call(msg)) )
+    {
+      dbus_bool_t v = 0;
+
+      if( dbus_message_get_args(rsp, &err,
+                                DBUS_TYPE_BOOLEAN, &v,
+                                DBUS_TYPE_INVALID) )
+      {
+        if( v != 0 ) res = 1;
+      }
+    }
+  }
+
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  dbus_error_free(&err);
 
-int
-profile_get_value_as_double(const char *profile, const char *key)
-{
-  char  *val = profile_get_value(profile, key);
-  double res = profile_parse_double(val);
-  free(val);
   return res;
 }
 
 /* ------------------------------------------------------------------------- *
- * profile_set_value_as_double  --
+ * profile_get_value  --  handle PROFILED_GET_VALUE method call
  * ------------------------------------------------------------------------- */
 
-int
-profile_set_value_as_double(const char *profile, const char *key, double val)
+char *
+profile_get_value(const char *profile, const char *key)
+{
+  char         *res = 0;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  DBusError    err  = DBUS_ERROR_INIT;
+  const char  *hit  = 0;
+  char        *name = 0;
+
+  client_check_profile(&profile);
+
+  if( (hit = profile_cache_get_value(profile, key)) != 0 )
+  {
+    res = strdup(hit);
+    goto cleanup;
+  }
+
+  // ask for the cached profile by name so that the reply can be cached
+  if( (name = profile_cache_resolve(profile)) != 0 )
+  {
+    profile = name;
+  }
+
+  if( (msg = client_make_method_message(PROFILED_GET_VALUE,
+                                        DBUS_TYPE_STRING, &profile,
+                                        DBUS_TYPE_STRING, &key,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    if( (rsp = client_exec_method_call(msg)) )
+    {
+      char *v = 0;
+      if( dbus_message_get_args(rsp, &err,
+                                DBUS_TYPE_STRING, &v,
+                                DBUS_TYPE_INVALID) )
+      {
+        res = strdup(v ?: "");
+
+        if( name != 0 )
+        {
+          profile_cache_set_value(name, key, res, 0);
+        }
+      }
+    }
+  }
+
+  cleanup:
+
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  dbus_error_free(&err);
+
+  free(name);
+
+  log_debug_F("%s(%s) = %s\n", key, profile, res);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_set_values
+ * ------------------------------------------------------------------------- */
+
+int
+profile_set_values(const char *profile, const profileval_t *values)
+{
+  int           res = -1;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  DBusError    err  = DBUS_ERROR_INIT;
+
+  DBusMessageIter iter, item;
+
+  static const char sgn[] =
+  DBUS_STRUCT_BEGIN_CHAR_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_STRUCT_END_CHAR_AS_STRING;
+
+  client_check_profile(&profile);
+
+  if( (msg = client_make_method_message(PROFILED_SET_VALUES,
+                                        DBUS_TYPE_INVALID)) == 0 )
+  {
+    goto cleanup;
+  }
+
+  dbus_message_iter_init_append(msg, &iter);
+
+  if( !dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, sgn, &item) )
+  {
+    goto cleanup;
+  }
+
+  for( size_t i = 0; values && values[i].pv_key; ++i )
+  {
+    const char *key = values[i].pv_key;
+    const char *val = values[i].pv_val ?: "";
+
+    if( encode_triplet(&item, &profile, &key, &val) < 0 )
+    {
+      goto cleanup;
+    }
+
+    profile_cache_forget_value(profile, key);
+  }
+
+  if( !dbus_message_iter_close_container(&iter, &item) )
+  {
+    goto cleanup;
+  }
+
+  if( (rsp = client_exec_method_call(msg)) )
+  {
+    dbus_bool_t v = 0;
+
+    if( dbus_message_get_args(rsp, &err,
+                              DBUS_TYPE_BOOLEAN, &v,
+                              DBUS_TYPE_INVALID) )
+    {
+      if( v != 0 ) res = 0;
+    }
+  }
+
+cleanup:
+
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  dbus_error_free(&err);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_set_value  --  handle PROFILED_SET_VALUE method call
+ * ------------------------------------------------------------------------- */
+
+int
+profile_set_value(const char *profile, const char *key, const char *val)
+{
+  int           res = -1;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  DBusError    err  = DBUS_ERROR_INIT;
+
+  client_check_profile(&profile);
+
+  profile_cache_forget_value(profile, key);
+
+  if( (msg = client_make_method_message(PROFILED_SET_VALUE,
+                                        DBUS_TYPE_STRING, &profile,
+                                        DBUS_TYPE_STRING, &key,
+                                        DBUS_TYPE_STRING, &val,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    if( (rsp = client_exec_method_call(msg)) )
+    {
+      dbus_bool_t v = 0;
+
+      if( dbus_message_get_args(rsp, &err,
+                                DBUS_TYPE_BOOLEAN, &v,
+                                DBUS_TYPE_INVALID) )
+      {
+        if( v != 0 ) res = 0;
+      }
+    }
+  }
+
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  dbus_error_free(&err);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_type  --  handle PROFILED_GET_TYPE method call
+ * ------------------------------------------------------------------------- */
+
+char *
+profile_get_type(const char *key)
+{
+  char         *res = 0;
+  DBusMessage  *msg = 0;
+  DBusMessage  *rsp = 0;
+  DBusError    err  = DBUS_ERROR_INIT;
+
+  if( (msg = client_make_method_message(PROFILED_GET_TYPE,
+                                        DBUS_TYPE_STRING, &key,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    if( (rsp = client_exec_method_call(msg)) )
+    {
+      char *v = 0;
+      if( dbus_message_get_args(rsp, &err,
+                                DBUS_TYPE_STRING, &v,
+                                DBUS_TYPE_INVALID) )
+      {
+        res = strdup(v ?: "");
+      }
+    }
+  }
+
+  if( rsp != 0 ) dbus_message_unref(rsp);
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  dbus_error_free(&err);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_parse_bool
+ * ------------------------------------------------------------------------- */
+
+int
+profile_parse_bool(const char *text)
+{
+  if( text != 0 )
+  {
+    for( size_t i = 0; profile_bool_true_values[i]; ++i )
+    {
+      if( !strcasecmp(profile_bool_true_values[i], text) )
+      {
+        return 1;
+      }
+    }
+
+    for( size_t i = 0; profile_bool_false_values[i]; ++i )
+    {
+      if( !strcasecmp(profile_bool_false_values[i], text) )
+      {
+        return 0;
+      }
+    }
+    return strtol(text, 0, 0) != 0;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_parse_int
+ * ------------------------------------------------------------------------- */
+
+int
+profile_parse_int(const char *text)
+{
+  return text ? strtol(text, 0, 0) : 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_parse_double
+ * ------------------------------------------------------------------------- */
+
+double
+profile_parse_double(const char *text)
+{
+  return text ? strtod(text, 0) : 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_value_as_bool
+ * ------------------------------------------------------------------------- */
+
+int
+profile_get_value_as_bool(const char *profile, const char *key)
+{
+  const profiletyped_t *hit = profile_cache_get_typed(profile, key);
+
+  if( hit != 0 )
+  {
+    return hit->tv_bool;
+  }
+
+  char *val = profile_get_value(profile, key);
+  int   res = profile_parse_bool(val);
+  free(val);
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_set_value_as_bool
+ * ------------------------------------------------------------------------- */
+
+int
+profile_set_value_as_bool(const char *profile, const char *key, int val)
+{
+  return profile_set_value(profile, key, val ?
+                           *profile_bool_true_values :
+                           *profile_bool_false_values);
+
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_value_as_int  --
+ * ------------------------------------------------------------------------- */
+
+int
+profile_get_value_as_int(const char *profile, const char *key)
+{
+  const profiletyped_t *hit = profile_cache_get_typed(profile, key);
+
+  if( hit != 0 )
+  {
+    return hit->tv_int;
+  }
+
+  char *val = profile_get_value(profile, key);
+  int   res = profile_parse_int(val);
+  free(val);
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_set_value_as_int  --
+ * ------------------------------------------------------------------------- */
+
+int
+profile_set_value_as_int(const char *profile, const char *key, int val)
+{
+  char tmp[32];
+  snprintf(tmp, sizeof tmp, "%d", val);
+  return profile_set_value(profile, key, tmp);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_value_as_double  --
+ * ------------------------------------------------------------------------- */
+
+int
+profile_get_value_as_double(const char *profile, const char *key)
+{
+  const profiletyped_t *hit = profile_cache_get_typed(profile, key);
+
+  if( hit != 0 )
+  {
+    return hit->tv_dbl;
+  }
+
+  char  *val = profile_get_value(profile, key);
+  double res = profile_parse_double(val);
+  free(val);
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_set_value_as_double  --
+ * ------------------------------------------------------------------------- */
+
+int
+profile_set_value_as_double(const char *profile, const char *key, double val)
 {
   char tmp[32];
   snprintf(tmp, sizeof tmp, "%.16g", val);
   return profile_set_value(profile, key, tmp);
 }
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_value_async  --  PROFILED_GET_VALUE without blocking
+ * ------------------------------------------------------------------------- */
+
+int
+profile_get_value_async(const char *profile, const char *key,
+                        profile_reply_value_fn cb, void *user_data,
+                        profile_user_data_free_fn free_cb)
+{
+  int          res = -1;
+  DBusMessage *msg = 0;
+
+  client_check_profile(&profile);
+
+  if( cb != 0 &&
+      (msg = client_make_method_message(PROFILED_GET_VALUE,
+                                        DBUS_TYPE_STRING, &profile,
+                                        DBUS_TYPE_STRING, &key,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    res = client_send_method_call(msg, client_reply_value_cb,
+                                  client_request_create(cb, user_data,
+                                                        free_cb));
+  }
+
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_set_value_async  --  PROFILED_SET_VALUE without blocking
+ * ------------------------------------------------------------------------- */
+
+int
+profile_set_value_async(const char *profile, const char *key,
+                        const char *val,
+                        profile_reply_status_fn cb, void *user_data,
+                        profile_user_data_free_fn free_cb)
+{
+  int          res = -1;
+  DBusMessage *msg = 0;
+
+  client_check_profile(&profile);
+
+  profile_cache_forget_value(profile, key);
+
+  if( (msg = client_make_method_message(PROFILED_SET_VALUE,
+                                        DBUS_TYPE_STRING, &profile,
+                                        DBUS_TYPE_STRING, &key,
+                                        DBUS_TYPE_STRING, &val,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    res = client_send_method_call(msg, client_reply_status_cb,
+                                  client_request_create(cb, user_data,
+                                                        free_cb));
+  }
+
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_values_async  --  PROFILED_GET_VALUES without blocking
+ * ------------------------------------------------------------------------- */
+
+int
+profile_get_values_async(const char *profile,
+                         profile_reply_values_fn cb, void *user_data,
+                         profile_user_data_free_fn free_cb)
+{
+  int          res = -1;
+  DBusMessage *msg = 0;
+
+  client_check_profile(&profile);
+
+  if( cb != 0 &&
+      (msg = client_make_method_message(PROFILED_GET_VALUES,
+                                        DBUS_TYPE_STRING, &profile,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    res = client_send_method_call(msg, client_reply_values_cb,
+                                  client_request_create(cb, user_data,
+                                                        free_cb));
+  }
+
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_get_profile_async  --  PROFILED_GET_PROFILE without blocking
+ * ------------------------------------------------------------------------- */
+
+int
+profile_get_profile_async(profile_reply_value_fn cb, void *user_data,
+                          profile_user_data_free_fn free_cb)
+{
+  int          res = -1;
+  DBusMessage *msg = 0;
+
+  if( cb != 0 &&
+      (msg = client_make_method_message(PROFILED_GET_PROFILE,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    res = client_send_method_call(msg, client_reply_value_cb,
+                                  client_request_create(cb, user_data,
+                                                        free_cb));
+  }
+
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_set_profile_async  --  PROFILED_SET_PROFILE without blocking
+ * ------------------------------------------------------------------------- */
+
+int
+profile_set_profile_async(const char *profile,
+                          profile_reply_status_fn cb, void *user_data,
+                          profile_user_data_free_fn free_cb)
+{
+  int          res = -1;
+  DBusMessage *msg = 0;
+
+  client_check_profile(&profile);
+
+  profile_cache_forget_active();
+
+  if( (msg = client_make_method_message(PROFILED_SET_PROFILE,
+                                        DBUS_TYPE_STRING, &profile,
+                                        DBUS_TYPE_INVALID)) )
+  {
+    res = client_send_method_call(msg, client_reply_status_cb,
+                                  client_request_create(cb, user_data,
+                                                        free_cb));
+  }
+
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_t  --  pipelined method calls
+ * ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  DBusMessage     *op_msg;   // method call
+  DBusPendingCall *op_pc;    // reply pending while batch is running
+  int              op_type;  // expected reply type
+  char            *op_val;   // string reply
+  int              op_res;   // 0 = success, -1 = error
+} client_batchop_t;
+
+struct profile_batch_t
+{
+  client_batchop_t *pb_op;
+  size_t            pb_count;
+};
+
+/* ------------------------------------------------------------------------- *
+ * client_batch_add  --  append method call to batch
+ * ------------------------------------------------------------------------- */
+
+static
+int
+client_batch_add(profile_batch_t *self, DBusMessage *msg, int type)
+{
+  int               res = -1;
+  client_batchop_t *arr = 0;
+
+  if( self == 0 || msg == 0 )
+  {
+    goto cleanup;
+  }
+
+  if( !(arr = realloc(self->pb_op, (self->pb_count + 1) * sizeof *arr)) )
+  {
+    goto cleanup;
+  }
+  self->pb_op = arr;
+
+  res = self->pb_count++;
+  arr[res].op_msg  = msg, msg = 0;
+  arr[res].op_pc   = 0;
+  arr[res].op_type = type;
+  arr[res].op_val  = 0;
+  arr[res].op_res  = -1;
+
+  cleanup:
+
+  if( msg != 0 ) dbus_message_unref(msg);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * client_batch_collect  --  wait for reply and store the result
+ * ------------------------------------------------------------------------- */
+
+static
+void
+client_batch_collect(client_batchop_t *op)
+{
+  DBusMessage *rsp = 0;
+  DBusError    err = DBUS_ERROR_INIT;
+  char        *v   = 0;
+  dbus_bool_t  b   = 0;
+
+  if( op->op_pc == 0 )
+  {
+    goto cleanup;
+  }
+
+  dbus_pending_call_block(op->op_pc);
+
+  if( (rsp = client_steal_reply(op->op_pc)) == 0 )
+  {
+    goto cleanup;
+  }
+
+  switch( op->op_type )
+  {
+  case DBUS_TYPE_STRING:
+    if( dbus_message_get_args(rsp, &err, DBUS_TYPE_STRING, &v,
+                              DBUS_TYPE_INVALID) )
+    {
+      op->op_val = strdup(v ?: "");
+      op->op_res = 0;
+    }
+    break;
+
+  case DBUS_TYPE_BOOLEAN:
+    if( dbus_message_get_args(rsp, &err, DBUS_TYPE_BOOLEAN, &b,
+                              DBUS_TYPE_INVALID) )
+    {
+      if( b != 0 ) op->op_res = 0;
+    }
+    break;
+  }
+
+  cleanup:
+
+  if( op->op_pc != 0 ) dbus_pending_call_unref(op->op_pc), op->op_pc = 0;
+  if( rsp != 0 ) dbus_message_unref(rsp);
+
+  dbus_error_free(&err);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_begin
+ * ------------------------------------------------------------------------- */
+
+profile_batch_t *
+profile_batch_begin(void)
+{
+  return calloc(1, sizeof(profile_batch_t));
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_add_get  --  queue PROFILED_GET_VALUE method call
+ * ------------------------------------------------------------------------- */
+
+int
+profile_batch_add_get(profile_batch_t *self,
+                      const char *profile, const char *key)
+{
+  client_check_profile(&profile);
+
+  return client_batch_add(self,
+                          client_make_method_message(PROFILED_GET_VALUE,
+                                                     DBUS_TYPE_STRING, &profile,
+                                                     DBUS_TYPE_STRING, &key,
+                                                     DBUS_TYPE_INVALID),
+                          DBUS_TYPE_STRING);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_add_set  --  queue PROFILED_SET_VALUE method call
+ * ------------------------------------------------------------------------- */
+
+int
+profile_batch_add_set(profile_batch_t *self,
+                      const char *profile, const char *key,
+                      const char *val)
+{
+  client_check_profile(&profile);
+
+  return client_batch_add(self,
+                          client_make_method_message(PROFILED_SET_VALUE,
+                                                     DBUS_TYPE_STRING, &profile,
+                                                     DBUS_TYPE_STRING, &key,
+                                                     DBUS_TYPE_STRING, &val,
+                                                     DBUS_TYPE_INVALID),
+                          DBUS_TYPE_BOOLEAN);
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_run  --  send all method calls, then collect all replies
+ * ------------------------------------------------------------------------- */
+
+int
+profile_batch_run(profile_batch_t *self)
+{
+  int             res  = -1;
+  DBusConnection *conn = 0;
+
+  if( self == 0 )
+  {
+    goto cleanup;
+  }
+
+  for( size_t i = 0; i < self->pb_count; ++i )
+  {
+    client_batchop_t *op = &self->pb_op[i];
+
+    free(op->op_val), op->op_val = 0;
+    op->op_res = -1;
+
+    if( op->op_type == DBUS_TYPE_BOOLEAN )
+    {
+      const char *profile = 0, *key = 0;
+
+      // set value: cached copy is not valid until change is signaled
+      if( dbus_message_get_args(op->op_msg, 0,
+                                DBUS_TYPE_STRING, &profile,
+                                DBUS_TYPE_STRING, &key,
+                                DBUS_TYPE_INVALID) )
+      {
+        profile_cache_forget_value(profile, key);
+      }
+    }
+  }
+
+  if( (conn = profile_connection_get_direct()) == 0 )
+  {
+    goto cleanup;
+  }
+
+  // queue all method calls before waiting for any reply
+  for( size_t i = 0; i < self->pb_count; ++i )
+  {
+    client_batchop_t *op  = &self->pb_op[i];
+    DBusMessage      *msg = 0;
+
+    // sent messages get a serial number -> send a copy so that
+    // the batch can be run again
+    if( (msg = dbus_message_copy(op->op_msg)) == 0 ||
+        !dbus_connection_send_with_reply(conn, msg, &op->op_pc,
+                                         DBUS_TIMEOUT_USE_DEFAULT) )
+    {
+      log_err_F("%s: %s\n", dbus_message_get_member(op->op_msg),
+                "dbus_connection_send_with_reply failed");
+    }
+
+    if( msg != 0 ) dbus_message_unref(msg);
+  }
+  dbus_connection_flush(conn);
+
+  res = 0;
+
+  for( size_t i = 0; i < self->pb_count; ++i )
+  {
+    client_batchop_t *op = &self->pb_op[i];
+
+    client_batch_collect(op);
+
+    if( op->op_res != 0 ) res = -1;
+  }
+
+  cleanup:
+
+  if( conn != 0 ) dbus_connection_unref(conn);
+
+  log_debug_F("%zd requests -> %d\n", self ? self->pb_count : 0, res);
+
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_get_status
+ * ------------------------------------------------------------------------- */
+
+int
+profile_batch_get_status(const profile_batch_t *self, int op)
+{
+  if( self == 0 || op < 0 || (size_t)op >= self->pb_count )
+  {
+    return -1;
+  }
+  return self->pb_op[op].op_res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_get_value
+ * ------------------------------------------------------------------------- */
+
+const char *
+profile_batch_get_value(const profile_batch_t *self, int op)
+{
+  if( self == 0 || op < 0 || (size_t)op >= self->pb_count )
+  {
+    return 0;
+  }
+  return self->pb_op[op].op_val;
+}
+
+/* ------------------------------------------------------------------------- *
+ * profile_batch_free
+ * ------------------------------------------------------------------------- */
+
+void
+profile_batch_free(profile_batch_t *self)
+{
+  if( self != 0 )
+  {
+    for( size_t i = 0; i < self->pb_count; ++i )
+    {
+      client_batchop_t *op = &self->pb_op[i];
+
+      if( op->op_pc  != 0 ) dbus_pending_call_unref(op->op_pc);
+      if( op->op_msg != 0 ) dbus_message_unref(op->op_msg);
+      free(op->op_val);
+    }
+    free(self->pb_op);
+    free(self);
+  }
+}
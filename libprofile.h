@@ -111,6 +111,40 @@ typedef void (*profile_track_value_fn_data)(const char *profile,
  */
 typedef void (*profile_user_data_free_fn)(void *user_data);
 
+/** \brief String reply callback
+ *
+ * Callback function type used for passing the result of
+ * asynchronous requests that return a string.
+ *
+ * @param val       value string, NULL on error
+ * @param user_data pointer specified when the request was made
+ */
+typedef void (*profile_reply_value_fn)(const char *val, void *user_data);
+
+/** \brief Status reply callback
+ *
+ * Callback function type used for passing the result of
+ * asynchronous requests that modify profile data.
+ *
+ * @param status    0 = success, -1 = error
+ * @param user_data pointer specified when the request was made
+ */
+typedef void (*profile_reply_status_fn)(int status, void *user_data);
+
+/** \brief Values reply callback
+ *
+ * Callback function type used for passing the result of
+ * asynchronous requests that return an array of values.
+ *
+ * The array is owned by libprofile and is valid only
+ * during the callback.
+ *
+ * @param values    NULL terminated array of values, NULL on error
+ * @param user_data pointer specified when the request was made
+ */
+typedef void (*profile_reply_values_fn)(const profileval_t *values,
+                                        void *user_data);
+
 /** \name Query Functions
  */
 /*@{*/
@@ -176,6 +210,45 @@ profileval_t *profile_get_values   (const char *profile);
  */
 void          profile_free_values  (profileval_t *values);
 
+/** \brief Snapshot of all profile data
+ *
+ * Returned by #profile_get_all(). The pa_profiles array is
+ * NULL terminated, pa_values has one values array for each
+ * profile name in the same order.
+ */
+typedef struct profileall_t
+{
+  char          *pa_active;   /**< currently active profile */
+  char         **pa_profiles; /**< available profile names */
+  profileval_t **pa_values;   /**< values for each profile */
+} profileall_t;
+
+/** \brief Batch of pipelined requests
+ *
+ * Opaque type used by #profile_batch_begin() and friends.
+ */
+typedef struct profile_batch_t profile_batch_t;
+
+/** \brief Get all profile data in one call
+ *
+ * Get the active profile name, available profiles and
+ * resolved values of every profile with a single method
+ * call.
+ *
+ * Use #profile_free_all() to free the result.
+ *
+ * @return      Profile data snapshot, NULL on error
+ */
+profileall_t *profile_get_all      (void);
+
+/** \brief Frees profile data snapshot
+ *
+ * Free profile data obtained via #profile_get_all() call.
+ *
+ * @param all profile data snapshot
+ */
+void          profile_free_all     (profileall_t *all);
+
 /** \brief Check if a profile exists
  *
  * Check if given profile exists.
@@ -238,6 +311,25 @@ char         *profile_get_value    (const char *profile, const char *key);
 int           profile_set_value    (const char *profile, const char *key,
                                     const char *val);
 
+/** \brief Set values of several profile keys
+ *
+ * Set values in profile in one transaction: either all
+ * values are set or, if any of them is not valid, none
+ * of them. All the changes are broadcast in one
+ * change signal.
+ *
+ * The values array is terminated by an entry with NULL
+ * pv_key, for example array returned by #profile_get_values()
+ * can be used. The pv_type members are ignored.
+ *
+ * @param profile profile name or NULL for current
+ * @param values  array of key and value pairs
+ *
+ * @returns 0 on success, -1 on failure
+ */
+int           profile_set_values   (const char *profile,
+                                    const profileval_t *values);
+
 /** \brief Check if a value can be modified
  *
  * Check if given profile value is writable.
@@ -260,6 +352,194 @@ char         *profile_get_type     (const char *key);
 
 /*@}*/
 
+/** \name Asynchronous Functions
+ *
+ * The asynchronous functions send the request and return
+ * immediately. The reply is passed to the callback function
+ * when the session bus connection is dispatched, i.e. the
+ * application must run the glib mainloop.
+ *
+ * If the request can not be sent, the functions return -1
+ * without calling the callback or the free function.
+ * Otherwise the callback is called exactly once, also when
+ * the request fails or times out, and after that user data
+ * is released via the free function if one was given.
+ */
+/*@{*/
+
+/** \brief Get profile value without blocking
+ *
+ * Asynchronous version of #profile_get_value().
+ *
+ * @param profile   profile name, or NULL for current profile
+ * @param key       value name
+ * @param cb        function to call with the value
+ * @param user_data pointer to pass to the callback
+ * @param free_cb   function for deallocating user_data, or NULL
+ *
+ * @returns 0 if request was sent, -1 on error
+ */
+int profile_get_value_async(const char *profile, const char *key,
+                            profile_reply_value_fn cb, void *user_data,
+                            profile_user_data_free_fn free_cb);
+
+/** \brief Set profile value without blocking
+ *
+ * Asynchronous version of #profile_set_value().
+ *
+ * @param profile   profile name, or NULL for current profile
+ * @param key       value name
+ * @param val       value string
+ * @param cb        function to call with the result, or NULL
+ * @param user_data pointer to pass to the callback
+ * @param free_cb   function for deallocating user_data, or NULL
+ *
+ * @returns 0 if request was sent, -1 on error
+ */
+int profile_set_value_async(const char *profile, const char *key,
+                            const char *val,
+                            profile_reply_status_fn cb, void *user_data,
+                            profile_user_data_free_fn free_cb);
+
+/** \brief Get all values of a profile without blocking
+ *
+ * Asynchronous version of #profile_get_values().
+ *
+ * @param profile   profile name, or NULL for current profile
+ * @param cb        function to call with the values
+ * @param user_data pointer to pass to the callback
+ * @param free_cb   function for deallocating user_data, or NULL
+ *
+ * @returns 0 if request was sent, -1 on error
+ */
+int profile_get_values_async(const char *profile,
+                             profile_reply_values_fn cb, void *user_data,
+                             profile_user_data_free_fn free_cb);
+
+/** \brief Get name of the current profile without blocking
+ *
+ * Asynchronous version of #profile_get_profile().
+ *
+ * @param cb        function to call with the profile name
+ * @param user_data pointer to pass to the callback
+ * @param free_cb   function for deallocating user_data, or NULL
+ *
+ * @returns 0 if request was sent, -1 on error
+ */
+int profile_get_profile_async(profile_reply_value_fn cb, void *user_data,
+                              profile_user_data_free_fn free_cb);
+
+/** \brief Set the active profile without blocking
+ *
+ * Asynchronous version of #profile_set_profile().
+ *
+ * @param profile   profile name
+ * @param cb        function to call with the result, or NULL
+ * @param user_data pointer to pass to the callback
+ * @param free_cb   function for deallocating user_data, or NULL
+ *
+ * @returns 0 if request was sent, -1 on error
+ */
+int profile_set_profile_async(const char *profile,
+                              profile_reply_status_fn cb, void *user_data,
+                              profile_user_data_free_fn free_cb);
+
+/*@}*/
+
+/** \name Batch Functions
+ *
+ * A batch collects get and set requests and sends them all
+ * to the profile daemon back to back, so that the whole batch
+ * costs roughly one round trip instead of one per request.
+ * The requests are handled by the daemon in the order they
+ * were added.
+ *
+ * Example:
+ * @code
+ * profile_batch_t *b = profile_batch_begin();
+ * int vol = profile_batch_add_get(b, 0, "ringing.alert.volume");
+ * profile_batch_add_set(b, 0, "ringing.alert.type", "Beep");
+ * profile_batch_run(b);
+ * printf("%s\n", profile_batch_get_value(b, vol));
+ * profile_batch_free(b);
+ * @endcode
+ */
+/*@{*/
+
+/** \brief Start a new batch
+ *
+ * Use #profile_batch_free() to release the batch.
+ *
+ * @returns batch object, NULL on error
+ */
+profile_batch_t *profile_batch_begin(void);
+
+/** \brief Add get value request to batch
+ *
+ * @param self    batch object
+ * @param profile profile name, or NULL for current profile
+ * @param key     value name
+ *
+ * @returns request index, -1 on error
+ */
+int profile_batch_add_get(profile_batch_t *self,
+                          const char *profile, const char *key);
+
+/** \brief Add set value request to batch
+ *
+ * @param self    batch object
+ * @param profile profile name, or NULL for current profile
+ * @param key     value name
+ * @param val     value string, empty string resets to default
+ *
+ * @returns request index, -1 on error
+ */
+int profile_batch_add_set(profile_batch_t *self,
+                          const char *profile, const char *key,
+                          const char *val);
+
+/** \brief Send all requests in the batch and wait for the replies
+ *
+ * Blocks until replies to all requests have been received.
+ * The batch can be run again, in which case the results of
+ * the previous run are replaced.
+ *
+ * @param self batch object
+ *
+ * @returns 0 if all requests succeeded, -1 otherwise
+ */
+int profile_batch_run(profile_batch_t *self);
+
+/** \brief Get result of a request after running the batch
+ *
+ * @param self batch object
+ * @param op   request index returned by #profile_batch_add_get()
+ *             or #profile_batch_add_set()
+ *
+ * @returns 0 if the request succeeded, -1 otherwise
+ */
+int profile_batch_get_status(const profile_batch_t *self, int op);
+
+/** \brief Get value returned by a get request after running the batch
+ *
+ * The string is owned by the batch and is valid until the
+ * batch is run again or released.
+ *
+ * @param self batch object
+ * @param op   request index returned by #profile_batch_add_get()
+ *
+ * @returns value string, NULL on error
+ */
+const char *profile_batch_get_value(const profile_batch_t *self, int op);
+
+/** \brief Release batch
+ *
+ * @param self batch object, or NULL
+ */
+void profile_batch_free(profile_batch_t *self);
+
+/*@}*/
+
 /** \name Tracking Functions
  */
 /*@{*/
@@ -502,12 +782,53 @@ void profile_connection_set(DBusConnection *con);
  * If non NULL connection is returned, the caller must release
  * it using dbus_connection_unref() after it is no longer needed.
  *
+ * If the profile daemon offers a peer-to-peer socket, libprofile
+ * makes method calls over a private connection to it instead,
+ * and uses the session bus connection only for change tracking
+ * and for finding the socket.
+ *
  * @returns session bus connection used by libprofile, or NULL
  */
 DBusConnection *profile_connection_get(void);
 
 /*@}*/
 
+/** \name Caching Functions
+ */
+/*@{*/
+
+/** \brief Serve profile reads from a local copy of profile data
+ *
+ * Normally every read like #profile_get_value() or
+ * #profile_get_value_as_bool() is a method call to the profile
+ * daemon. After enabling the cache, values of all profiles are
+ * fetched with one method call on the first read, and further
+ * reads of the active profile name, values and value arrays
+ * are served locally. Cached values are also kept in parsed
+ * form, so #profile_get_value_as_bool(), #profile_get_value_as_int()
+ * and #profile_get_value_as_double() do not parse strings again.
+ *
+ * The local copy is kept up to date from the same change
+ * signals that are used for change tracking, so the cache is
+ * used only while tracking is active, see #profile_tracker_init().
+ * The application must also dispatch the session bus connection,
+ * usually by running the glib mainloop. Changes made by other
+ * processes become visible when the change signal is handled.
+ *
+ * The cached data is dropped when the session bus connection
+ * changes or the profile daemon restarts.
+ */
+void profile_cache_enable(void);
+
+/** \brief Stop serving profile reads from local copy
+ *
+ * Releases the cached data, further reads are method calls
+ * to the profile daemon.
+ */
+void profile_cache_disable(void);
+
+/*@}*/
+
 /** \name Convenience Functions
  */
 /*@{*/
@@ -42,6 +42,8 @@
 #include <time.h>
 #include <errno.h>
 
+#include <glib.h>
+
 #ifdef LOGGING_ENABLED
 
 static int log_level   = LOG_WARNING;
@@ -187,14 +189,17 @@ log_emit(int level, const char *fmt, ...)
      *
      * Possible direct calls to syslog from elsewhere
      * means that this can't be made 100% safe.
+     *
+     * The saver thread logs too, so the counter must
+     * be updated atomically.
      */
 
     va_list va;
     va_start(va, fmt);
 
-    static volatile int syslog_cnt = 0;
+    static gint syslog_cnt = 0;
 
-    if( ++syslog_cnt == 1 )
+    if( g_atomic_int_add(&syslog_cnt, 1) == 0 )
     {
       log_emit_syslog(level, fmt, va);
     }
@@ -202,7 +207,7 @@ log_emit(int level, const char *fmt, ...)
     {
       log_emit_stderr(level, fmt, va);
     }
-    --syslog_cnt;
+    g_atomic_int_dec_and_test(&syslog_cnt);
 
     va_end(va);
   }
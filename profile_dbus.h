@@ -145,6 +145,22 @@
  **/
 # define PROFILED_SET_VALUE    "set_value"
 
+/**
+ * Set several profile values in one transaction.
+ *
+ * The values are either all set or, if any of them
+ * is not valid, none of them. All changes are reported
+ * in one change signal.
+ *
+ * @param   values  : ARRAY of STRUCT
+ *         <br> profile : STRING
+ *         <br> key     : STRING
+ *         <br> val     : STRING
+ *
+ * @returns success : BOOLEAN
+ **/
+# define PROFILED_SET_VALUES   "set_values"
+
 /**
  * Get type of profile value.
  *
@@ -167,6 +183,44 @@
  **/
 # define PROFILED_GET_VALUES   "get_values"
 
+/**
+ * Get active profile, available profiles and values of all
+ * profiles in one call.
+ *
+ * @returns profile  : STRING
+ * @returns profiles : ARRAY of STRING
+ * @returns values   : ARRAY of STRUCT
+ *         <br> profile : STRING
+ *         <br> values  : ARRAY of STRUCT
+ *         <br> &nbsp; key  : STRING
+ *         <br> &nbsp; val  : STRING
+ *         <br> &nbsp; type : STRING
+ **/
+# define PROFILED_GET_ALL      "get_all"
+
+/**
+ * Write all pending changes to persistent storage.
+ *
+ * Profile data is normally saved in batches some time after
+ * changes are made. This method can be used e.g. before system
+ * suspend to make sure nothing is left unsaved.
+ *
+ * @returns success : BOOLEAN
+ **/
+# define PROFILED_SYNC         "sync"
+
+/**
+ * Get address of the peer-to-peer socket of profile daemon.
+ *
+ * Clients can open a private connection to this address and
+ * make method calls without going through the bus daemon.
+ * Signals are sent only via the bus. Only clients running as
+ * the same user as the daemon are accepted.
+ *
+ * @returns address : STRING, empty if not enabled
+ **/
+# define PROFILED_GET_DIRECT_ADDRESS "get_direct_address"
+
 /*@}*/
 
 /** @name DBus Signals
@@ -158,6 +158,21 @@ static int track(void)
   return exit_code;
 }
 
+static void reset(const char *profile)
+{
+  char           **keys  = profile_get_keys();
+  profile_batch_t *batch = profile_batch_begin();
+
+  for( size_t i = 0; keys && keys[i]; ++i )
+  {
+    profile_batch_add_set(batch, profile, keys[i], "");
+  }
+  profile_batch_run(batch);
+
+  profile_batch_free(batch);
+  profile_free_keys(keys);
+}
+
 static const char usage[] =
 "NAME\n"
 "  profileclient  --  command line utility for profile daemon access\n"
@@ -239,14 +254,15 @@ int main(int argc, char **argv)
       break;
 
     case 'l':
-      p = profile_get_profile();
-      w = profile_get_profiles();
-      for( size_t i = 0; w && w[i]; ++i )
       {
-        printf("%s%s\n", w[i], strcmp(w[i],p) ? "" : "*");
+        profileall_t *a = profile_get_all();
+        for( size_t i = 0; a && a->pa_profiles[i]; ++i )
+        {
+          p = a->pa_profiles[i];
+          printf("%s%s\n", p, xstrsame(p, a->pa_active) ? "*" : "");
+        }
+        profile_free_all(a);
       }
-      profile_free_profiles(w);
-      free(p);
       break;
 
     case 'k':
@@ -259,21 +275,11 @@ int main(int argc, char **argv)
       break;
 
     case 'r':
-      w = profile_get_keys();
-      for( size_t i = 0; w && w[i]; ++i )
-      {
-        profile_set_value(0, w[i], "");
-      }
-      profile_free_keys(w);
+      reset(0);
       break;
 
     case 'R':
-      w = profile_get_keys();
-      for( size_t i = 0; w && w[i]; ++i )
-      {
-        profile_set_value(optarg, w[i], "");
-      }
-      profile_free_keys(w);
+      reset(optarg);
       break;
 
     case 'v':
@@ -0,0 +1,274 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include "profiled_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glob.h>
+
+#include "logging.h"
+#include "database.h"
+#include "inifile.h"
+#include "datatype.h"
+#include "staticdb.h"
+
+/* ========================================================================= *
+ * Validation
+ * ========================================================================= */
+
+static int compile_errors = 0;
+
+static void compile_error(const char *sec, const char *key,
+                          const char *fmt, ...)
+__attribute__((format(printf,3,4)));
+
+/* ------------------------------------------------------------------------- *
+ * compile_error  --  report configuration inconsistency
+ * ------------------------------------------------------------------------- */
+
+static
+void
+compile_error(const char *sec, const char *key, const char *fmt, ...)
+{
+  va_list va;
+
+  fprintf(stderr, "[%s] %s: ", sec, key);
+  va_start(va, fmt);
+  vfprintf(stderr, fmt, va);
+  va_end(va);
+
+  compile_errors += 1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * compile_check_value  --  value must be acceptable for key datatype
+ * ------------------------------------------------------------------------- */
+
+static
+void
+compile_check_value(inifile_t *ini, const inisec_t *sec, const inival_t *val)
+{
+  const char *spec = inifile_get(ini, DATATYPE, val->iv_key, 0);
+
+  if( spec == 0 )
+  {
+    compile_error(sec->is_name, val->iv_key, "no datatype\n");
+  }
+  else if( !xstrnull(val->iv_val) )
+  {
+    datatype_t *type = datatype_create(spec);
+
+    if( datatype_parse(type, val->iv_val, 0) != 0 )
+    {
+      compile_error(sec->is_name, val->iv_key,
+                    "value '%s' does not match datatype '%s'\n",
+                    val->iv_val, spec);
+    }
+    datatype_delete(type);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * compile_check  --  apply the rules profiled uses for static values
+ *
+ * Keys are made available by profiled only if they have both datatype
+ * and fallback value, and values that do not match the datatype are
+ * rejected when set by clients. Configuration that relies on anything
+ * else is reported as an error.
+ * ------------------------------------------------------------------------- */
+
+static
+int
+compile_check(inifile_t *ini)
+{
+  for( size_t i = 0; i < ini->if_sections.st_count; ++i )
+  {
+    const inisec_t *sec = ini->if_sections.st_elem[i];
+
+    for( size_t k = 0; k < sec->is_values.st_count; ++k )
+    {
+      const inival_t *val = sec->is_values.st_elem[k];
+
+      if( !strcmp(sec->is_name, DATATYPE) )
+      {
+        if( !inifile_has(ini, FALLBACK, val->iv_key) )
+        {
+          compile_error(sec->is_name, val->iv_key, "no fallback value\n");
+        }
+      }
+      else if( !strcmp(sec->is_name, SETTINGS) )
+      {
+        // daemon settings are not profile values
+      }
+      else
+      {
+        compile_check_value(ini, sec, val);
+      }
+    }
+  }
+  return compile_errors ? -1 : 0;
+}
+
+/* ========================================================================= *
+ * Main
+ * ========================================================================= */
+
+static const char usage[] =
+"NAME\n"
+"  profiled-compile  --  validate and compile profiled configuration\n"
+"\n"
+"SYNOPSIS\n"
+"  profiled-compile [options] [<ini file> ...]\n"
+"\n"
+"DESCRIPTION\n"
+"    Merges the given ini files, in the given order, in the same\n"
+"    way as profiled does,\n"
+"    checks that every value matches its datatype and that every\n"
+"    datatype has a fallback value, and writes a binary snapshot\n"
+"    that profiled can load instead of parsing the ini files.\n"
+"\n"
+"    Without file arguments "CONFIG_GLOB" is used.\n"
+"\n"
+"    The snapshot is valid only as long as the ini files keep the\n"
+"    same names, sizes and modification times, so it should be\n"
+"    made from the installed files, e.g. at package install time.\n"
+"\n"
+"OPTIONS\n"
+"  -h\n"
+"       This help text\n"
+"  -n\n"
+"       Only validate, do not write snapshot.\n"
+"  -o <path>\n"
+"       Write snapshot to path instead of "CONFIG_SNAPSHOT".\n"
+"\n"
+"EXIT STATUS\n"
+"  Non-zero if files could not be read, the configuration has\n"
+"  errors or the snapshot could not be written.\n"
+"\n"
+"SEE ALSO\n"
+"  profiled\n";
+
+int
+main(int argc, char **argv)
+{
+  int         exit_code = EXIT_FAILURE;
+  int         check     = 0;
+  const char *output    = CONFIG_SNAPSHOT;
+  staticdb_t *snapshot  = 0;
+  inifile_t  *ini       = 0;
+  glob_t      globbuf   = { .gl_pathc = 0 };
+  int         opt;
+
+  log_open("profiled-compile", 0);
+
+  while( (opt = getopt(argc, argv, "hno:")) != -1 )
+  {
+    switch( opt )
+    {
+    case 'h':
+      if( write(STDOUT_FILENO, usage, sizeof usage - 1) == -1 )
+      {
+        // we do not really care, but keep static analyzers happy
+      }
+      exit(0);
+
+    case 'n':
+      check = 1;
+      break;
+
+    case 'o':
+      output = optarg;
+      break;
+
+    default: /* '?' */
+      fprintf(stderr, "(use -h for usage info)\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  char * const *sources = argv + optind;
+  size_t        count   = argc - optind;
+
+  if( count == 0 )
+  {
+    glob(CONFIG_GLOB, GLOB_MARK, 0, &globbuf);
+    sources = globbuf.gl_pathv;
+    count   = globbuf.gl_pathc;
+  }
+
+  if( count == 0 )
+  {
+    fprintf(stderr, "no configuration files\n");
+    goto cleanup;
+  }
+
+  /* stat before parsing, see staticdb_create() */
+  if( !check && !(snapshot = staticdb_create(output, sources, count)) )
+  {
+    goto cleanup;
+  }
+
+  ini = inifile_create_arena();
+
+  if( staticdb_parse(ini, sources, count) == -1 )
+  {
+    fprintf(stderr, "failed to read configuration files\n");
+    goto cleanup;
+  }
+
+  if( compile_check(ini) == -1 )
+  {
+    fprintf(stderr, "%d errors, snapshot not written\n", compile_errors);
+    goto cleanup;
+  }
+
+  if( snapshot != 0 && staticdb_save(snapshot, ini) == -1 )
+  {
+    goto cleanup;
+  }
+
+  exit_code = EXIT_SUCCESS;
+
+  cleanup:
+
+  inifile_delete(ini);
+  staticdb_delete(snapshot);
+  globfree(&globbuf);
+
+  log_close();
+
+  return exit_code;
+}
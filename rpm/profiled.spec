@@ -10,6 +10,7 @@ Requires(post): /sbin/ldconfig
 Requires(postun): /sbin/ldconfig
 BuildRequires:  pkgconfig(dbus-1)
 BuildRequires:  pkgconfig(glib-2.0)
+BuildRequires:  pkgconfig(gthread-2.0)
 BuildRequires:  doxygen
 
 %description
@@ -71,7 +72,17 @@ make %{build_variables} install-libprofile-doc
 make %{build_variables} install-profileclient
 rm %{buildroot}/%{_libdir}/libprofile.a
 
-%post -p /sbin/ldconfig
+%post
+/sbin/ldconfig
+%{_bindir}/profiled-compile || :
+
+# Settings packages install ini files after profiled itself; rebuild
+# the config snapshot whenever they change.
+%filetriggerin -- %{_sysconfdir}/profiled/
+%{_bindir}/profiled-compile || :
+
+%filetriggerpostun -- %{_sysconfdir}/profiled/
+%{_bindir}/profiled-compile || :
 
 %postun -p /sbin/ldconfig
 
@@ -79,6 +90,8 @@ rm %{buildroot}/%{_libdir}/libprofile.a
 %license LICENSE
 %dir %{_sysconfdir}/profiled
 %{_bindir}/%{name}
+%{_bindir}/profiled-compile
+%ghost %{_sysconfdir}/profiled/profiled.db
 %{_libdir}/libprofile.so.*
 %{_datadir}/dbus-1/services/com.nokia.profiled.service
 %{_userunitdir}/profiled.service
@@ -0,0 +1,338 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+
+#include "profiled_config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <glib.h>
+
+#include "savesched.h"
+#include "logging.h"
+
+/* ========================================================================= *
+ * Configuration
+ * ========================================================================= */
+
+enum
+{
+  SAVESCHED_WINDOW    = 2000, /* [ms] default batching window */
+  SAVESCHED_LIMIT     = 240,  /* default maximum saves per hour */
+  SAVESCHED_RETRY     = 60,   /* [s] default delay before first retry */
+
+  SAVESCHED_RETRY_MAX = 3600, /* [s] upper bound for retry delay */
+  SAVESCHED_LIMIT_MAX = 3600, /* upper bound for saves per hour */
+  SAVESCHED_HOUR      = 3600 * 1000, /* [ms] */
+};
+
+/* ========================================================================= *
+ * Module Data
+ * ========================================================================= */
+
+static void (*savesched_save_cb)(void) = 0;
+
+static savepolicy_t savesched_policy =
+{
+  .sp_window = SAVESCHED_WINDOW,
+  .sp_limit  = SAVESCHED_LIMIT,
+  .sp_retry  = SAVESCHED_RETRY,
+};
+
+static guint    savesched_timer_id = 0; // pending save or retry
+static int      savesched_pending  = 0; // unsaved changes exist
+static int      savesched_backoff  = 0; // [s] current retry delay
+
+// start times of recent saves, ring buffer of sp_limit entries
+static int64_t *savesched_history = 0;
+static size_t   savesched_history_pos = 0;
+static size_t   savesched_history_cnt = 0;
+
+/* ========================================================================= *
+ * Internal Functions
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * savesched_now  --  monotonic time stamp in milliseconds
+ * ------------------------------------------------------------------------- */
+
+static
+int64_t
+savesched_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_allowed  --  earliest time the next save is allowed at
+ * ------------------------------------------------------------------------- */
+
+static
+int64_t
+savesched_allowed(int64_t now)
+{
+  if( savesched_policy.sp_limit <= 0 ||
+      savesched_history_cnt < (size_t)savesched_policy.sp_limit )
+  {
+    return now;
+  }
+
+  // ring is full -> oldest entry is at the write position
+  int64_t at = savesched_history[savesched_history_pos] + SAVESCHED_HOUR;
+  return (at > now) ? at : now;
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_record  --  remember start time of a save
+ * ------------------------------------------------------------------------- */
+
+static
+void
+savesched_record(int64_t now)
+{
+  size_t size = savesched_policy.sp_limit;
+
+  if( savesched_history != 0 && size > 0 )
+  {
+    savesched_history[savesched_history_pos] = now;
+    savesched_history_pos = (savesched_history_pos + 1) % size;
+
+    if( savesched_history_cnt < size )
+    {
+      ++savesched_history_cnt;
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_disarm  --  cancel save timer
+ * ------------------------------------------------------------------------- */
+
+static
+void
+savesched_disarm(void)
+{
+  if( savesched_timer_id != 0 )
+  {
+    g_source_remove(savesched_timer_id);
+    savesched_timer_id = 0;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_timer_cb  --  start save when it is allowed
+ * ------------------------------------------------------------------------- */
+
+static
+gboolean
+savesched_timer_cb(gpointer aptr)
+{
+  (void)aptr;
+
+  int64_t now = savesched_now();
+  int64_t at  = savesched_allowed(now);
+
+  savesched_timer_id = 0;
+
+  if( at > now )
+  {
+    log_notice("save rate limit reached, postponing save by %d s\n",
+               (int)((at - now + 999) / 1000));
+    savesched_timer_id = g_timeout_add(at - now, savesched_timer_cb, 0);
+    return FALSE;
+  }
+
+  savesched_pending = 0;
+  savesched_record(now);
+
+  if( savesched_save_cb != 0 )
+  {
+    savesched_save_cb();
+  }
+  return FALSE;
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_arm  --  schedule save after given delay
+ * ------------------------------------------------------------------------- */
+
+static
+void
+savesched_arm(int64_t delay)
+{
+  savesched_disarm();
+  savesched_timer_id = g_timeout_add(delay, savesched_timer_cb, 0);
+}
+
+/* ========================================================================= *
+ * External API
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * savesched_init  --  set function that starts the actual save
+ * ------------------------------------------------------------------------- */
+
+void
+savesched_init(void (*save_cb)(void))
+{
+  savesched_save_cb = save_cb;
+  savesched_set_policy(0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_quit  --  cancel pending saves and release resources
+ * ------------------------------------------------------------------------- */
+
+void
+savesched_quit(void)
+{
+  savesched_cancel();
+  savesched_save_cb = 0;
+  savesched_backoff = 0;
+
+  free(savesched_history), savesched_history = 0;
+  savesched_history_pos = 0;
+  savesched_history_cnt = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_set_policy  --  change batching, rate limit & retry policy
+ * ------------------------------------------------------------------------- */
+
+void
+savesched_set_policy(const savepolicy_t *policy)
+{
+  savepolicy_t use =
+  {
+    .sp_window = SAVESCHED_WINDOW,
+    .sp_limit  = SAVESCHED_LIMIT,
+    .sp_retry  = SAVESCHED_RETRY,
+  };
+
+  if( policy != 0 )
+  {
+    if( policy->sp_window >= 0 ) use.sp_window = policy->sp_window;
+    if( policy->sp_limit  >= 0 ) use.sp_limit  = policy->sp_limit;
+    if( policy->sp_retry  >  0 ) use.sp_retry  = policy->sp_retry;
+  }
+
+  if( use.sp_limit > SAVESCHED_LIMIT_MAX ) use.sp_limit = SAVESCHED_LIMIT_MAX;
+  if( use.sp_retry > SAVESCHED_RETRY_MAX ) use.sp_retry = SAVESCHED_RETRY_MAX;
+
+  if( use.sp_limit != savesched_policy.sp_limit || savesched_history == 0 )
+  {
+    // start rate limit tracking from scratch
+    free(savesched_history), savesched_history = 0;
+    savesched_history_pos = 0;
+    savesched_history_cnt = 0;
+
+    if( use.sp_limit > 0 )
+    {
+      savesched_history = calloc(use.sp_limit, sizeof *savesched_history);
+    }
+  }
+
+  savesched_policy = use;
+
+  log_debug("save policy: window %d ms, limit %d/h, retry %d s\n",
+            use.sp_window, use.sp_limit, use.sp_retry);
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_request  --  schedule save of changed data
+ *
+ * The first request starts the batching window, further requests
+ * made before the window closes are saved by the same save.
+ * ------------------------------------------------------------------------- */
+
+void
+savesched_request(void)
+{
+  savesched_pending = 1;
+
+  if( savesched_timer_id == 0 )
+  {
+    savesched_arm(savesched_policy.sp_window);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_finished  --  handle result of a save
+ * ------------------------------------------------------------------------- */
+
+void
+savesched_finished(int error)
+{
+  if( error != 0 )
+  {
+    if( savesched_backoff == 0 )
+    {
+      savesched_backoff = savesched_policy.sp_retry;
+    }
+    else if( (savesched_backoff *= 2) > SAVESCHED_RETRY_MAX )
+    {
+      savesched_backoff = SAVESCHED_RETRY_MAX;
+    }
+
+    log_warning("database save failed - retry in %d s\n", savesched_backoff);
+
+    savesched_pending = 1;
+    savesched_arm((int64_t)savesched_backoff * 1000);
+  }
+  else if( savesched_backoff != 0 )
+  {
+    log_warning("database save retry - success\n");
+    savesched_backoff = 0;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * savesched_cancel  --  cancel scheduled save
+ *
+ * Returns nonzero if there were unsaved changes, i.e. the caller
+ * should save synchronously.
+ * ------------------------------------------------------------------------- */
+
+int
+savesched_cancel(void)
+{
+  int pending = savesched_pending;
+
+  savesched_disarm();
+  savesched_pending = 0;
+
+  return pending;
+}
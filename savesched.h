@@ -0,0 +1,74 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+
+#ifndef SAVESCHED_H_
+# define SAVESCHED_H_
+
+# ifdef __cplusplus
+extern "C" {
+# elif 0
+} /* fool JED indentation ... */
+# endif
+
+typedef struct savepolicy_t savepolicy_t;
+
+/* ------------------------------------------------------------------------- *
+ * savepolicy_t
+ * ------------------------------------------------------------------------- */
+
+/* Save requests made within sp_window from the first unsaved change
+ * are written to flash together. At most sp_limit saves are started
+ * per hour, requests exceeding that are postponed. Failed saves are
+ * retried after sp_retry seconds, doubling the delay on each further
+ * failure. Negative values select the built-in defaults. */
+
+struct savepolicy_t
+{
+  int sp_window; // [ms] batching window
+  int sp_limit;  // maximum number of saves per hour, 0 = no limit
+  int sp_retry;  // [s] delay before the first retry
+};
+
+void savesched_init      (void (*save_cb)(void));
+void savesched_quit      (void);
+void savesched_set_policy(const savepolicy_t *policy);
+void savesched_request   (void);
+void savesched_finished  (int error);
+int  savesched_cancel    (void);
+
+# ifdef __cplusplus
+};
+# endif
+
+#endif /* SAVESCHED_H_ */
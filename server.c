@@ -46,6 +46,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "dbus-gmain/dbus-gmain.h"
 
@@ -71,6 +72,14 @@ enum
 
 static DBusConnection *server_bus    = NULL;
 
+/* Optional peer-to-peer socket for clients that want to bypass
+ * the bus daemon for method calls, see PROFILED_GET_DIRECT_ADDRESS */
+static DBusServer      *server_direct = NULL;
+static char            *server_direct_address = NULL;
+
+static DBusConnection **server_peer   = NULL;
+static size_t           server_peers  = 0;
+
 /* ------------------------------------------------------------------------- *
  * server_make_reply  --  create method call responce message
  * ------------------------------------------------------------------------- */
@@ -107,6 +116,21 @@ introspect(DBusMessage *msg)
     "\"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">\n"
     "<node>\n"
     "   <interface name=\"com.nokia.profiled\">\n"
+    "      <method name=\"get_all\">\n"
+    "         <arg type=\"s\" direction=\"out\"/>\n"
+    "         <arg type=\"as\" direction=\"out\"/>\n"
+    "         <arg type=\"a(sa(sss))\" direction=\"out\"/>\n"
+    "      </method>\n"
+    "      <method name=\"set_values\">\n"
+    "         <arg type=\"a(sss)\" direction=\"in\"/>\n"
+    "         <arg type=\"b\" direction=\"out\"/>\n"
+    "      </method>\n"
+    "      <method name=\"sync\">\n"
+    "         <arg type=\"b\" direction=\"out\"/>\n"
+    "      </method>\n"
+    "      <method name=\"get_direct_address\">\n"
+    "         <arg type=\"s\" direction=\"out\"/>\n"
+    "      </method>\n"
     "      <signal name=\"profile_changed\">\n"
     "         <arg type=\"b\" direction=\"out\"/>\n"
     "         <arg type=\"b\" direction=\"out\"/>\n"
@@ -129,16 +153,15 @@ static
 DBusMessage *
 server_get_profiles(DBusMessage *msg)
 {
-  DBusMessage *rsp = 0;
-  int          len = 0;
-  char       **vec = database_get_profiles(&len);
+  DBusMessage        *rsp = 0;
+  int                 len = 0;
+  const char * const *vec = database_get_profiles(&len);
 
 // QUARANTINE   debugf("@ server_get_profiles() -> %p %d\n", vec, len);
 
   rsp = server_make_reply(msg,
                           DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &vec, len,
                           DBUS_TYPE_INVALID);
-  database_free_profiles(vec);
 
   log_info("%s -> reply: %d names\n", __FUNCTION__, len);
   return rsp;
@@ -237,15 +260,14 @@ static
 DBusMessage *
 server_get_keys(DBusMessage *msg)
 {
-  char       **vec = 0;
-  int          len = 0;
-  DBusMessage *rsp = 0;
+  const char * const *vec = 0;
+  int                 len = 0;
+  DBusMessage        *rsp = 0;
 
   vec = database_get_keys(&len);
   rsp = server_make_reply(msg,
                           DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &vec, len,
                           DBUS_TYPE_INVALID);
-  database_free_keys(vec);
 
   log_info("%s -> reply: %d names\n", __FUNCTION__, len);
   return rsp;
@@ -308,6 +330,82 @@ server_get_values(DBusMessage *msg)
   return rsp;
 }
 
+/* ------------------------------------------------------------------------- *
+ * server_get_all  --  handle PROFILED_GET_ALL method call
+ * ------------------------------------------------------------------------- */
+
+static
+DBusMessage *
+server_get_all(DBusMessage *msg)
+{
+  DBusMessage        *rsp  = 0;
+  const char         *curr = database_get_profile();
+  int                 cnt  = 0;
+  const char * const *prof = database_get_profiles(&cnt);
+
+  DBusMessageIter iter, item, memb, vals;
+
+  static const char sgn[] =
+  DBUS_STRUCT_BEGIN_CHAR_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_TYPE_ARRAY_AS_STRING
+  DBUS_STRUCT_BEGIN_CHAR_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_STRUCT_END_CHAR_AS_STRING
+  DBUS_STRUCT_END_CHAR_AS_STRING;
+
+  static const char vsgn[] =
+  DBUS_STRUCT_BEGIN_CHAR_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_TYPE_STRING_AS_STRING
+  DBUS_STRUCT_END_CHAR_AS_STRING;
+
+  rsp = server_make_reply(msg,
+                          DBUS_TYPE_STRING, &curr,
+                          DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &prof, cnt,
+                          DBUS_TYPE_INVALID);
+  if( rsp == 0 )
+  {
+    goto cleanup;
+  }
+
+  dbus_message_iter_init_append(rsp, &iter);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, sgn, &item);
+
+  for( int p = 0; p < cnt; ++p )
+  {
+    int           len = 0;
+    profileval_t *vec = database_get_values(prof[p], &len);
+
+    dbus_message_iter_open_container(&item, DBUS_TYPE_STRUCT, 0, &memb);
+    encode_string(&memb, (const char **)&prof[p]);
+    dbus_message_iter_open_container(&memb, DBUS_TYPE_ARRAY, vsgn, &vals);
+
+    for( int i = 0; i < len; ++i )
+    {
+      const char *key  = vec[i].pv_key;
+      const char *val  = vec[i].pv_val;
+      const char *type = vec[i].pv_type;
+      encode_triplet(&vals, &key, &val, &type);
+    }
+
+    dbus_message_iter_close_container(&memb, &vals);
+    dbus_message_iter_close_container(&item, &memb);
+
+    database_free_values(vec);
+  }
+
+  dbus_message_iter_close_container(&iter, &item);
+
+cleanup:
+
+  log_info("%s -> reply: %d profiles\n", __FUNCTION__, cnt);
+  return rsp;
+}
+
 /* ------------------------------------------------------------------------- *
  * server_set_value  --  handle PROFILED_SET_VALUE method call
  * ------------------------------------------------------------------------- */
@@ -347,6 +445,62 @@ server_set_value(DBusMessage *msg)
   return rsp;
 }
 
+/* ------------------------------------------------------------------------- *
+ * server_set_values  --  handle PROFILED_SET_VALUES method call
+ * ------------------------------------------------------------------------- */
+
+static
+DBusMessage *
+server_set_values(DBusMessage *msg)
+{
+  DBusMessage     *rsp  = 0;
+  dbus_bool_t      res  = 0;
+  const char     **vec  = 0;
+  int              cnt  = 0;
+  int              top  = 0;
+  DBusMessageIter  iter, item;
+
+  dbus_message_iter_init(msg, &iter);
+
+  if( dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY )
+  {
+    log_err("%s: %s\n", dbus_message_get_member(msg), "expected a(sss)");
+    goto cleanup;
+  }
+
+  dbus_message_iter_recurse(&iter, &item);
+
+  while( dbus_message_iter_get_arg_type(&item) != DBUS_TYPE_INVALID )
+  {
+    if( cnt == top )
+    {
+      top = top ? top * 2 : 16;
+      vec = realloc(vec, 3 * top * sizeof *vec);
+    }
+
+    const char **trip = &vec[3 * cnt];
+
+    if( decode_triplet(&item, &trip[0], &trip[1], &trip[2]) < 0 )
+    {
+      log_err("%s: %s\n", dbus_message_get_member(msg), "expected a(sss)");
+      goto cleanup;
+    }
+    ++cnt;
+  }
+
+  res = (database_set_values(vec, cnt) == 0);
+
+cleanup:
+
+  rsp = server_make_reply(msg, DBUS_TYPE_BOOLEAN, &res, DBUS_TYPE_INVALID);
+
+  free(vec);
+
+  log_info("%s -> reply: %s (%d values)\n", __FUNCTION__,
+           res ? "True" : "False", cnt);
+  return rsp;
+}
+
 /* ------------------------------------------------------------------------- *
  * server_has_value  --  handle PROFILED_HAS_VALUE method call
  * ------------------------------------------------------------------------- */
@@ -417,6 +571,34 @@ server_is_writable(DBusMessage *msg)
   return rsp;
 }
 
+/* ------------------------------------------------------------------------- *
+ * server_sync  --  handle PROFILED_SYNC method call
+ * ------------------------------------------------------------------------- */
+
+static
+DBusMessage *
+server_sync(DBusMessage *msg)
+{
+  dbus_bool_t res = (database_save_flush() == 0);
+
+  log_info("%s -> reply: %s\n", __FUNCTION__, res ? "True" : "False");
+  return server_make_reply(msg, DBUS_TYPE_BOOLEAN, &res, DBUS_TYPE_INVALID);
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_get_direct_address  --  handle PROFILED_GET_DIRECT_ADDRESS call
+ * ------------------------------------------------------------------------- */
+
+static
+DBusMessage *
+server_get_direct_address(DBusMessage *msg)
+{
+  const char *res = server_direct_address ?: "";
+
+  log_info("%s -> reply: '%s'\n", __FUNCTION__, res);
+  return server_make_reply(msg, DBUS_TYPE_STRING, &res, DBUS_TYPE_INVALID);
+}
+
 /* ------------------------------------------------------------------------- *
  * server_get_value  --  handle PROFILED_GET_VALUE method call
  * ------------------------------------------------------------------------- */
@@ -489,6 +671,27 @@ server_get_type(DBusMessage *msg)
   return rsp;
 }
 
+/* ------------------------------------------------------------------------- *
+ * server_peer_remove  --  release peer-to-peer client connection
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_peer_remove(DBusConnection *conn)
+{
+  for( size_t i = 0; i < server_peers; ++i )
+  {
+    if( server_peer[i] == conn )
+    {
+      log_debug("peer-to-peer client disconnected\n");
+      server_peer[i] = server_peer[--server_peers];
+      dbus_connection_close(conn);
+      dbus_connection_unref(conn);
+      break;
+    }
+  }
+}
+
 /* ------------------------------------------------------------------------- *
  * server_filter  -- handle requests coming via dbus
  * ------------------------------------------------------------------------- */
@@ -515,6 +718,14 @@ server_filter(DBusConnection *conn,
     goto cleanup;
   }
 
+  if( conn != server_bus &&
+      dbus_message_is_signal(msg, DBUS_INTERFACE_LOCAL, "Disconnected") )
+  {
+    /* Peer-to-peer client went away */
+    server_peer_remove(conn);
+    goto cleanup;
+  }
+
   if( dbus_message_is_signal(msg, DBUS_INTERFACE_LOCAL, "Disconnected") )
   {
     /* Make a orderly shutdown if we get disconnected from
@@ -571,14 +782,20 @@ server_filter(DBusConnection *conn,
 
         {PROFILED_GET_KEYS,     server_get_keys},
         {PROFILED_GET_VALUES,   server_get_values},
+        {PROFILED_GET_ALL,      server_get_all},
 
         {PROFILED_GET_TYPE,     server_get_type},
 
         {PROFILED_GET_VALUE,    server_get_value},
         {PROFILED_SET_VALUE,    server_set_value},
+        {PROFILED_SET_VALUES,   server_set_values},
         {PROFILED_HAS_VALUE,    server_has_value},
         {PROFILED_IS_WRITABLE,  server_is_writable},
 
+        {PROFILED_SYNC,         server_sync},
+
+        {PROFILED_GET_DIRECT_ADDRESS, server_get_direct_address},
+
         {0,0}
       };
 
@@ -891,6 +1108,378 @@ server_restart_cb(void)
   }
 }
 
+/* ------------------------------------------------------------------------- *
+ * server_direct_new_cb  --  accept peer-to-peer client connection
+ *
+ * The default authentication accepts only clients running as the
+ * same user as the daemon.
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_direct_new_cb(DBusServer *server, DBusConnection *conn, void *data)
+{
+  (void)server; (void)data;
+
+  DBusConnection **arr = realloc(server_peer,
+                                 (server_peers + 1) * sizeof *arr);
+
+  if( arr == 0 || !dbus_connection_add_filter(conn, server_filter, 0, 0) )
+  {
+    log_err("peer-to-peer client: %s\n", "setup failed");
+    server_peer = arr ?: server_peer;
+    return;
+  }
+
+  server_peer = arr;
+  server_peer[server_peers++] = dbus_connection_ref(conn);
+
+  dbus_gmain_set_up_connection(conn, NULL);
+  dbus_connection_set_exit_on_disconnect(conn, 0);
+
+  log_debug("peer-to-peer client connected\n");
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_direct_init  --  start listening on peer-to-peer socket
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_direct_init(void)
+{
+  DBusError  err  = DBUS_ERROR_INIT;
+  char      *dir  = 0;
+  char      *addr = 0;
+
+  if( database_get_setting(SETTINGS_DIRECT, 0) == 0 )
+  {
+    goto cleanup;
+  }
+
+  /* socket in per user runtime dir, with generated name */
+  dir  = dbus_address_escape_value(g_get_user_runtime_dir());
+  addr = g_strdup_printf("unix:dir=%s", dir ?: "/tmp");
+
+  if( (server_direct = dbus_server_listen(addr, &err)) == 0 )
+  {
+    log_warning("%s: %s: %s\n", "dbus_server_listen",
+                err.name, err.message);
+    goto cleanup;
+  }
+
+  dbus_server_set_new_connection_function(server_direct,
+                                          server_direct_new_cb, 0, 0);
+  dbus_gmain_set_up_server(server_direct, NULL);
+
+  server_direct_address = dbus_server_get_address(server_direct);
+  log_info("peer-to-peer address: %s\n", server_direct_address);
+
+  cleanup:
+
+  dbus_error_free(&err);
+  dbus_free(dir);
+  g_free(addr);
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_direct_quit  --  stop listening and drop peer-to-peer clients
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_direct_quit(void)
+{
+  while( server_peers != 0 )
+  {
+    server_peer_remove(server_peer[0]);
+  }
+  free(server_peer), server_peer = 0;
+
+  if( server_direct != 0 )
+  {
+    dbus_server_disconnect(server_direct);
+    dbus_server_unref(server_direct);
+    server_direct = 0;
+  }
+
+  dbus_free(server_direct_address), server_direct_address = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * Pending changes must reach flash before the device suspends. A logind
+ * delay inhibitor holds off sleep until PrepareForSleep(true) has been
+ * handled, changes are flushed synchronously and then the inhibitor is
+ * released; it is taken again on resume.
+ * ------------------------------------------------------------------------- */
+
+#define LOGIND_SERVICE   "org.freedesktop.login1"
+#define LOGIND_PATH      "/org/freedesktop/login1"
+#define LOGIND_INTERFACE "org.freedesktop.login1.Manager"
+#define LOGIND_INHIBIT   "Inhibit"
+#define LOGIND_SLEEP     "PrepareForSleep"
+
+static const char server_sleep_rule[] =
+"type='signal'"
+",sender='"LOGIND_SERVICE"'"
+",path='"LOGIND_PATH"'"
+",interface='"LOGIND_INTERFACE"'"
+",member='"LOGIND_SLEEP"'";
+
+static DBusConnection  *server_system     = NULL;
+static DBusPendingCall *server_sleep_pc   = NULL;
+static int              server_sleep_fd   = -1;
+
+/* ------------------------------------------------------------------------- *
+ * server_sleep_release  --  allow suspend to proceed
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_sleep_release(void)
+{
+  if( server_sleep_pc != 0 )
+  {
+    dbus_pending_call_cancel(server_sleep_pc);
+    dbus_pending_call_unref(server_sleep_pc);
+    server_sleep_pc = 0;
+  }
+
+  if( server_sleep_fd != -1 )
+  {
+    log_debug("suspend inhibitor released\n");
+    close(server_sleep_fd), server_sleep_fd = -1;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_sleep_inhibit_cb  --  handle reply to logind Inhibit call
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_sleep_inhibit_cb(DBusPendingCall *pc, void *data)
+{
+  (void)data;
+
+  DBusMessage *rsp = 0;
+  DBusError    err = DBUS_ERROR_INIT;
+  int          fd  = -1;
+
+  if( pc != server_sleep_pc )
+  {
+    goto cleanup;
+  }
+
+  rsp = dbus_pending_call_steal_reply(pc);
+  dbus_pending_call_unref(server_sleep_pc), server_sleep_pc = 0;
+
+  if( rsp == 0 )
+  {
+    goto cleanup;
+  }
+
+  if( dbus_set_error_from_message(&err, rsp) ||
+      !dbus_message_get_args(rsp, &err,
+                             DBUS_TYPE_UNIX_FD, &fd,
+                             DBUS_TYPE_INVALID) )
+  {
+    log_warning("%s: %s: %s\n", LOGIND_INHIBIT, err.name, err.message);
+    goto cleanup;
+  }
+
+  if( server_sleep_fd != -1 )
+  {
+    close(server_sleep_fd);
+  }
+  server_sleep_fd = fd, fd = -1;
+
+  log_debug("suspend inhibitor taken\n");
+
+  cleanup:
+
+  if( fd != -1 )
+  {
+    close(fd);
+  }
+
+  if( rsp != 0 )
+  {
+    dbus_message_unref(rsp);
+  }
+
+  dbus_error_free(&err);
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_sleep_inhibit  --  ask logind to delay suspend for us
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_sleep_inhibit(void)
+{
+  DBusMessage *msg  = 0;
+  const char  *what = "sleep";
+  const char  *who  = "profiled";
+  const char  *why  = "Saving profile data";
+  const char  *mode = "delay";
+
+  if( server_system == 0 || server_sleep_pc != 0 || server_sleep_fd != -1 )
+  {
+    goto cleanup;
+  }
+
+  msg = dbus_message_new_method_call(LOGIND_SERVICE,
+                                     LOGIND_PATH,
+                                     LOGIND_INTERFACE,
+                                     LOGIND_INHIBIT);
+  if( msg == 0 )
+  {
+    goto cleanup;
+  }
+
+  if( !dbus_message_append_args(msg,
+                                DBUS_TYPE_STRING, &what,
+                                DBUS_TYPE_STRING, &who,
+                                DBUS_TYPE_STRING, &why,
+                                DBUS_TYPE_STRING, &mode,
+                                DBUS_TYPE_INVALID) )
+  {
+    goto cleanup;
+  }
+
+  if( !dbus_connection_send_with_reply(server_system, msg,
+                                       &server_sleep_pc, -1) ||
+      server_sleep_pc == 0 )
+  {
+    log_warning("%s: %s\n", LOGIND_INHIBIT, "failed to send");
+    goto cleanup;
+  }
+
+  if( !dbus_pending_call_set_notify(server_sleep_pc,
+                                    server_sleep_inhibit_cb, 0, 0) )
+  {
+    dbus_pending_call_cancel(server_sleep_pc);
+    dbus_pending_call_unref(server_sleep_pc), server_sleep_pc = 0;
+  }
+
+  cleanup:
+
+  if( msg != 0 )
+  {
+    dbus_message_unref(msg);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_sleep_filter  --  flush changes when logind announces suspend
+ * ------------------------------------------------------------------------- */
+
+static
+DBusHandlerResult
+server_sleep_filter(DBusConnection *conn, DBusMessage *msg, void *data)
+{
+  (void)conn; (void)data;
+
+  dbus_bool_t suspend = FALSE;
+  DBusError   err     = DBUS_ERROR_INIT;
+
+  if( !dbus_message_is_signal(msg, LOGIND_INTERFACE, LOGIND_SLEEP) )
+  {
+    goto cleanup;
+  }
+
+  if( !dbus_message_get_args(msg, &err,
+                             DBUS_TYPE_BOOLEAN, &suspend,
+                             DBUS_TYPE_INVALID) )
+  {
+    log_err("%s: %s: %s\n", LOGIND_SLEEP, err.name, err.message);
+    goto cleanup;
+  }
+
+  if( suspend )
+  {
+    log_notice("suspending, flushing changes\n");
+    if( database_save_flush() == -1 )
+    {
+      log_err("failed to save changes before suspend\n");
+    }
+    server_sleep_release();
+  }
+  else
+  {
+    server_sleep_inhibit();
+  }
+
+  cleanup:
+
+  dbus_error_free(&err);
+
+  /* other filters on a shared connection may want it too */
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_sleep_init  --  start tracking system suspend
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_sleep_init(void)
+{
+  DBusError err = DBUS_ERROR_INIT;
+
+  /* with USE_SYSTEM_BUS this is the same shared connection
+   * as server_bus and already attached to the mainloop */
+  if( (server_system = dbus_bus_get(DBUS_BUS_SYSTEM, &err)) == 0 )
+  {
+    log_warning("%s: %s: %s\n", "system bus", err.name, err.message);
+    goto cleanup;
+  }
+
+  if( server_system != server_bus )
+  {
+    dbus_gmain_set_up_connection(server_system, NULL);
+    dbus_connection_set_exit_on_disconnect(server_system, 0);
+  }
+
+  if( !dbus_connection_add_filter(server_system, server_sleep_filter, 0, 0) )
+  {
+    dbus_connection_unref(server_system), server_system = 0;
+    goto cleanup;
+  }
+
+  dbus_bus_add_match(server_system, server_sleep_rule, 0);
+
+  server_sleep_inhibit();
+
+  cleanup:
+
+  dbus_error_free(&err);
+}
+
+/* ------------------------------------------------------------------------- *
+ * server_sleep_quit  --  stop tracking system suspend
+ * ------------------------------------------------------------------------- */
+
+static
+void
+server_sleep_quit(void)
+{
+  server_sleep_release();
+
+  if( server_system != 0 )
+  {
+    if( dbus_connection_get_is_connected(server_system) )
+    {
+      dbus_bus_remove_match(server_system, server_sleep_rule, 0);
+    }
+    dbus_connection_remove_filter(server_system, server_sleep_filter, 0);
+    dbus_connection_unref(server_system), server_system = 0;
+  }
+}
+
 /* ------------------------------------------------------------------------- *
  * server_init
  * ------------------------------------------------------------------------- */
@@ -974,6 +1563,18 @@ server_init(void)
   dbus_gmain_set_up_connection(server_bus, NULL);
   dbus_connection_set_exit_on_disconnect(server_bus, 0);
 
+  /* - - - - - - - - - - - - - - - - - - - *
+   * optional peer-to-peer socket
+   * - - - - - - - - - - - - - - - - - - - */
+
+  server_direct_init();
+
+  /* - - - - - - - - - - - - - - - - - - - *
+   * flush changes before system suspend
+   * - - - - - - - - - - - - - - - - - - - */
+
+  server_sleep_init();
+
   /* - - - - - - - - - - - - - - - - - - - *
    * success
    * - - - - - - - - - - - - - - - - - - - */
@@ -1006,6 +1607,12 @@ server_quit(void)
   // save data if we have unhandled changes
   server_changes_save();
 
+  // drop peer-to-peer clients
+  server_direct_quit();
+
+  // stop tracking suspend
+  server_sleep_quit();
+
   // detach from dbus
   if( server_bus != 0 )
   {
@@ -0,0 +1,603 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include "profiled_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "staticdb.h"
+#include "logging.h"
+#include "atom.h"
+#include "symtab.h"
+#include "xutil.h"
+
+/* ========================================================================= *
+ * File Format
+ * ========================================================================= */
+
+/* All integers are in host byte order, the snapshot is a local cache
+ * and is simply rebuilt if magic or version do not match.
+ *
+ *   head                      staticdb_head_t
+ *   files[sh_sources]         staticdb_file_t
+ *   sections[sh_sections]     staticdb_sec_t
+ *   values[sh_values]         staticdb_val_t
+ *   pool[sh_pool]             nul terminated strings
+ *
+ * Sections and values are stored in the same order as they are in
+ * the inifile_t the snapshot was made from, values of each section
+ * are stored consecutively. String references are offsets to pool. */
+
+enum
+{
+  STATICDB_MAGIC   = 0x42445350, // "PSDB"
+  STATICDB_VERSION = 1,
+};
+
+typedef struct
+{
+  uint32_t sh_magic;
+  uint32_t sh_version;
+  uint32_t sh_size;     // total file size
+  uint32_t sh_sources;
+  uint32_t sh_sections;
+  uint32_t sh_values;
+  uint32_t sh_pool;     // string pool size
+  uint32_t sh_check;    // checksum of everything after the header
+} staticdb_head_t;
+
+typedef struct
+{
+  uint32_t sf_path;
+  uint32_t sf_mtime_nsec;
+  int64_t  sf_mtime;
+  uint64_t sf_size;
+  uint64_t sf_ino;
+} staticdb_file_t;
+
+typedef struct
+{
+  uint32_t sc_name;
+  uint32_t sc_first;
+  uint32_t sc_count;
+} staticdb_sec_t;
+
+typedef struct
+{
+  uint32_t sv_key;
+  uint32_t sv_val;
+} staticdb_val_t;
+
+/* ========================================================================= *
+ * staticpool_t  --  string pool used while writing snapshots
+ * ========================================================================= */
+
+typedef struct staticstr_t  staticstr_t;
+typedef struct staticpool_t staticpool_t;
+
+struct staticstr_t
+{
+  const char *ss_str; // atom
+  uint32_t    ss_off;
+};
+
+struct staticpool_t
+{
+  symtab_t *sp_index;
+  char     *sp_data;
+  size_t    sp_size;
+  size_t    sp_alloc;
+};
+
+/* ------------------------------------------------------------------------- *
+ * staticstr_create_cb
+ * ------------------------------------------------------------------------- */
+
+static
+void *
+staticstr_create_cb(const char *str)
+{
+  staticstr_t *self = calloc(1, sizeof *self);
+  self->ss_str = atom_intern(str);
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticstr_delete_cb
+ * ------------------------------------------------------------------------- */
+
+static
+void
+staticstr_delete_cb(void *self)
+{
+  staticstr_t *str = self;
+  atom_release(str->ss_str);
+  free(str);
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticstr_getkey_cb
+ * ------------------------------------------------------------------------- */
+
+static
+const char *
+staticstr_getkey_cb(const void *self)
+{
+  return ((const staticstr_t *)self)->ss_str;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticpool_ctor
+ * ------------------------------------------------------------------------- */
+
+static
+void
+staticpool_ctor(staticpool_t *self)
+{
+  self->sp_index = symtab_create_atoms(staticstr_create_cb,
+                                       staticstr_delete_cb,
+                                       staticstr_getkey_cb);
+  self->sp_data  = 0;
+  self->sp_size  = 0;
+  self->sp_alloc = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticpool_dtor
+ * ------------------------------------------------------------------------- */
+
+static
+void
+staticpool_dtor(staticpool_t *self)
+{
+  symtab_delete(self->sp_index), self->sp_index = 0;
+  free(self->sp_data), self->sp_data = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticpool_add  --  get pool offset of string, add it if needed
+ * ------------------------------------------------------------------------- */
+
+static
+uint32_t
+staticpool_add(staticpool_t *self, const char *str)
+{
+  staticstr_t *ent = symtab_lookup(self->sp_index, str);
+
+  if( ent == 0 )
+  {
+    size_t len = strlen(str) + 1;
+
+    if( self->sp_size + len > self->sp_alloc )
+    {
+      size_t need = self->sp_size + len;
+      self->sp_alloc = self->sp_alloc ? self->sp_alloc : 4096;
+      while( self->sp_alloc < need ) self->sp_alloc *= 2;
+      self->sp_data = realloc(self->sp_data, self->sp_alloc);
+    }
+
+    ent = symtab_insert(self->sp_index, str);
+    ent->ss_off = self->sp_size;
+
+    memcpy(self->sp_data + self->sp_size, str, len);
+    self->sp_size += len;
+  }
+  return ent->ss_off;
+}
+
+/* ========================================================================= *
+ * staticdb_t
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * staticdb_create  --  stat source files that the snapshot depends on
+ * ------------------------------------------------------------------------- */
+
+staticdb_t *
+staticdb_create(const char *path, char * const *sources, size_t count)
+{
+  staticdb_t *self = calloc(1, sizeof *self);
+
+  self->sd_path   = strdup(path);
+  self->sd_count  = count;
+  self->sd_source = calloc(count, sizeof *self->sd_source);
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    staticsrc_t *src = &self->sd_source[i];
+
+    src->ss_path = strdup(sources[i]);
+
+    if( stat(src->ss_path, &src->ss_stat) == -1 )
+    {
+      log_warning("%s: stat: %s\n", src->ss_path, strerror(errno));
+      staticdb_delete(self), self = 0;
+      break;
+    }
+  }
+
+  return self;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticdb_delete
+ * ------------------------------------------------------------------------- */
+
+void
+staticdb_delete(staticdb_t *self)
+{
+  if( self != 0 )
+  {
+    for( size_t i = 0; i < self->sd_count; ++i )
+    {
+      free(self->sd_source[i].ss_path);
+    }
+    free(self->sd_source);
+    free(self->sd_path);
+    free(self);
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticdb_check_sources  --  snapshot matches current source files?
+ * ------------------------------------------------------------------------- */
+
+static
+int
+staticdb_check_sources(const staticdb_t *self,
+                       const staticdb_file_t *file,
+                       const char *pool)
+{
+  for( size_t i = 0; i < self->sd_count; ++i )
+  {
+    const staticsrc_t *src = &self->sd_source[i];
+
+    if( strcmp(pool + file[i].sf_path, src->ss_path) ||
+        file[i].sf_size       != (uint64_t)src->ss_stat.st_size ||
+        file[i].sf_mtime      != (int64_t)src->ss_stat.st_mtim.tv_sec ||
+        file[i].sf_mtime_nsec != (uint32_t)src->ss_stat.st_mtim.tv_nsec ||
+        file[i].sf_ino        != (uint64_t)src->ss_stat.st_ino )
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticdb_load  --  populate inifile from up to date snapshot
+ * ------------------------------------------------------------------------- */
+
+int
+staticdb_load(const staticdb_t *self, inifile_t *ini)
+{
+  int     err  = -1;
+  int     file = -1;
+  void   *data = MAP_FAILED;
+  size_t  size = 0;
+
+  struct stat st;
+
+  if( self == 0 )
+  {
+    goto cleanup;
+  }
+
+  if( (file = open(self->sd_path, O_RDONLY)) == -1 )
+  {
+    if( errno != ENOENT )
+    {
+      log_warning("%s: open: %s\n", self->sd_path, strerror(errno));
+    }
+    goto cleanup;
+  }
+
+  if( fstat(file, &st) == -1 || (size_t)st.st_size < sizeof(staticdb_head_t) )
+  {
+    goto cleanup;
+  }
+  size = st.st_size;
+
+  if( (data = mmap(0, size, PROT_READ, MAP_PRIVATE, file, 0)) == MAP_FAILED )
+  {
+    log_warning("%s: mmap: %s\n", self->sd_path, strerror(errno));
+    goto cleanup;
+  }
+
+  const staticdb_head_t *head = data;
+
+  if( head->sh_magic   != STATICDB_MAGIC   ||
+      head->sh_version != STATICDB_VERSION ||
+      head->sh_size    != size )
+  {
+    log_debug("%s: not a valid snapshot\n", self->sd_path);
+    goto cleanup;
+  }
+
+  uint64_t need = (sizeof *head +
+                   (uint64_t)head->sh_sources  * sizeof(staticdb_file_t) +
+                   (uint64_t)head->sh_sections * sizeof(staticdb_sec_t) +
+                   (uint64_t)head->sh_values   * sizeof(staticdb_val_t) +
+                   head->sh_pool);
+
+  if( need != size )
+  {
+    log_warning("%s: snapshot size mismatch\n", self->sd_path);
+    goto cleanup;
+  }
+
+  if( head->sh_check != xhash(head + 1, size - sizeof *head) )
+  {
+    log_warning("%s: snapshot checksum mismatch\n", self->sd_path);
+    goto cleanup;
+  }
+
+  const staticdb_file_t *files = (const void *)(head + 1);
+  const staticdb_sec_t  *secs  = (const void *)(files + head->sh_sources);
+  const staticdb_val_t  *vals  = (const void *)(secs + head->sh_sections);
+  const char            *pool  = (const void *)(vals + head->sh_values);
+  uint32_t               plen  = head->sh_pool;
+
+  /* All string offsets must point inside a nul terminated pool */
+
+  if( plen == 0 || pool[plen-1] != 0 )
+  {
+    log_warning("%s: snapshot string pool corrupted\n", self->sd_path);
+    goto cleanup;
+  }
+
+  for( uint32_t i = 0; i < head->sh_sources; ++i )
+  {
+    if( files[i].sf_path >= plen ) goto corrupted;
+  }
+  for( uint32_t i = 0; i < head->sh_sections; ++i )
+  {
+    if( secs[i].sc_name >= plen ||
+        secs[i].sc_first > head->sh_values ||
+        secs[i].sc_count > head->sh_values - secs[i].sc_first ) goto corrupted;
+  }
+  for( uint32_t i = 0; i < head->sh_values; ++i )
+  {
+    if( vals[i].sv_key >= plen || vals[i].sv_val >= plen ) goto corrupted;
+  }
+
+  /* Snapshot must be made from the current set of source files */
+
+  if( head->sh_sources != self->sd_count ||
+      staticdb_check_sources(self, files, pool) == -1 )
+  {
+    log_debug("%s: snapshot is out of date\n", self->sd_path);
+    goto cleanup;
+  }
+
+  /* The tables are free of duplicates, so the values can be added
+   * without hash index updates and indexed once at the end */
+
+  for( uint32_t i = 0; i < head->sh_sections; ++i )
+  {
+    inisec_t *sec = inifile_add_section(ini, pool + secs[i].sc_name);
+
+    for( uint32_t k = 0; k < secs[i].sc_count; ++k )
+    {
+      const staticdb_val_t *val = &vals[secs[i].sc_first + k];
+      inisec_append(sec, pool + val->sv_key, pool + val->sv_val);
+    }
+  }
+  inifile_reindex(ini);
+
+  log_debug("%s: loaded %u sections, %u values\n", self->sd_path,
+            head->sh_sections, head->sh_values);
+
+  err = 0;
+  goto cleanup;
+
+  corrupted:
+
+  log_warning("%s: snapshot tables corrupted\n", self->sd_path);
+
+  cleanup:
+
+  if( data != MAP_FAILED ) munmap(data, size);
+
+  if( file != -1 ) close(file);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticdb_save  --  write snapshot of inifile
+ * ------------------------------------------------------------------------- */
+
+int
+staticdb_save(const staticdb_t *self, const inifile_t *ini)
+{
+  int              err   = -1;
+  char            *work  = 0;
+  char            *data  = 0;
+  staticdb_file_t *files = 0;
+  staticdb_sec_t  *secs  = 0;
+  staticdb_val_t  *vals  = 0;
+  size_t           nsec  = ini->if_sections.st_count;
+  size_t           nval  = 0;
+
+  staticpool_t pool;
+
+  staticpool_ctor(&pool);
+
+  if( self == 0 )
+  {
+    goto cleanup;
+  }
+
+  for( size_t i = 0; i < nsec; ++i )
+  {
+    const inisec_t *sec = ini->if_sections.st_elem[i];
+    nval += sec->is_values.st_count;
+  }
+
+  files = calloc(self->sd_count, sizeof *files);
+  secs  = calloc(nsec, sizeof *secs);
+  vals  = calloc(nval, sizeof *vals);
+
+  for( size_t i = 0; i < self->sd_count; ++i )
+  {
+    const staticsrc_t *src = &self->sd_source[i];
+
+    files[i].sf_path       = staticpool_add(&pool, src->ss_path);
+    files[i].sf_mtime      = src->ss_stat.st_mtim.tv_sec;
+    files[i].sf_mtime_nsec = src->ss_stat.st_mtim.tv_nsec;
+    files[i].sf_size       = src->ss_stat.st_size;
+    files[i].sf_ino        = src->ss_stat.st_ino;
+  }
+
+  for( size_t i = 0, v = 0; i < nsec; ++i )
+  {
+    const inisec_t *sec = ini->if_sections.st_elem[i];
+
+    secs[i].sc_name  = staticpool_add(&pool, sec->is_name);
+    secs[i].sc_first = v;
+    secs[i].sc_count = sec->is_values.st_count;
+
+    for( size_t k = 0; k < sec->is_values.st_count; ++k, ++v )
+    {
+      const inival_t *val = sec->is_values.st_elem[k];
+      vals[v].sv_key = staticpool_add(&pool, val->iv_key);
+      vals[v].sv_val = staticpool_add(&pool, val->iv_val);
+    }
+  }
+
+  /* Empty pool would not pass the load time sanity checks */
+  staticpool_add(&pool, "");
+
+  staticdb_head_t head =
+  {
+    .sh_magic    = STATICDB_MAGIC,
+    .sh_version  = STATICDB_VERSION,
+    .sh_sources  = self->sd_count,
+    .sh_sections = nsec,
+    .sh_values   = nval,
+    .sh_pool     = pool.sp_size,
+  };
+
+  size_t size = (sizeof head +
+                 self->sd_count * sizeof *files +
+                 nsec * sizeof *secs +
+                 nval * sizeof *vals +
+                 pool.sp_size);
+
+  if( size > UINT32_MAX )
+  {
+    log_warning("%s: too much data for snapshot\n", self->sd_path);
+    goto cleanup;
+  }
+  head.sh_size = size;
+
+  char *pos = data = malloc(size);
+  memcpy(pos, &head, sizeof head),                    pos += sizeof head;
+  memcpy(pos, files, self->sd_count * sizeof *files), pos += self->sd_count * sizeof *files;
+  memcpy(pos, secs,  nsec * sizeof *secs),            pos += nsec * sizeof *secs;
+  memcpy(pos, vals,  nval * sizeof *vals),            pos += nval * sizeof *vals;
+  memcpy(pos, pool.sp_data, pool.sp_size);
+
+  ((staticdb_head_t *)data)->sh_check =
+    xhash(data + sizeof head, size - sizeof head);
+
+  /* Write to temporary file and rename over the old snapshot, so
+   * that an interrupted save can not leave a truncated snapshot */
+
+  work = xstrfmt("%s.tmp", self->sd_path);
+
+  if( xsavefile(work, 0644, data, size) == -1 )
+  {
+    goto cleanup;
+  }
+
+  if( rename(work, self->sd_path) == -1 )
+  {
+    log_warning("%s: rename: %s\n", self->sd_path, strerror(errno));
+    goto cleanup;
+  }
+
+  log_debug("%s: saved %zu sections, %zu values\n", self->sd_path,
+            nsec, nval);
+
+  err = 0;
+
+  cleanup:
+
+  if( err == -1 && work != 0 ) remove(work);
+
+  staticpool_dtor(&pool);
+  free(work);
+  free(data);
+  free(files);
+  free(secs);
+  free(vals);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * staticdb_parse  --  merge source ini files the way profiled does
+ *
+ * Each file is parsed on its own and then merged, values from later
+ * files override the earlier ones. Returns -1 if any of the files
+ * could not be read.
+ * ------------------------------------------------------------------------- */
+
+int
+staticdb_parse(inifile_t *ini, char * const *sources, size_t count)
+{
+  int err = 0;
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    inifile_t *layer = inifile_create_arena();
+
+    if( inifile_load(layer, sources[i]) == -1 )
+    {
+      err = -1;
+    }
+    inifile_merge(ini, layer);
+    inifile_delete(layer);
+  }
+  inifile_reindex(ini);
+
+  return err;
+}
@@ -0,0 +1,92 @@
+
+/******************************************************************************
+** This file is part of profile-qt
+**
+** Copyright (C) 2010 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** Redistributions of source code must retain the above copyright notice,
+** this list of conditions and the following disclaimer. Redistributions in
+** binary form must reproduce the above copyright notice, this list of
+** conditions and the following disclaimer in the documentation  and/or
+** other materials provided with the distribution.
+**
+** Neither the name of Nokia Corporation nor the names of its contributors
+** may be used to endorse or promote products derived from this software 
+** without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+** THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+** PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+** CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+** EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+** PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+** OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+** WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+** OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef STATICDB_H_
+# define STATICDB_H_
+
+# include <sys/types.h>
+# include <sys/stat.h>
+
+# include "inifile.h"
+
+# ifdef __cplusplus
+extern "C" {
+# elif 0
+} /* fool JED indentation ... */
+# endif
+
+typedef struct staticsrc_t staticsrc_t;
+typedef struct staticdb_t  staticdb_t;
+
+/* ------------------------------------------------------------------------- *
+ * staticdb_t
+ * ------------------------------------------------------------------------- */
+
+/* Binary snapshot of merged static configuration.
+ *
+ * The snapshot file holds section and value tables that refer to
+ * a pool of unique nul terminated strings, and identity of the ini
+ * files it was made from. It can be used instead of parsing the ini
+ * files as long as the file names, sizes and modification times have
+ * not changed.
+ *
+ * Source file stats are taken when the staticdb_t is created, i.e.
+ * before the ini files are parsed, so that a file modified during
+ * parsing can not end up in a snapshot marked as up to date. */
+
+struct staticsrc_t
+{
+  char        *ss_path;
+  struct stat  ss_stat;
+};
+
+struct staticdb_t
+{
+  char        *sd_path;   // snapshot file
+  size_t       sd_count;  // number of source files
+  staticsrc_t *sd_source; // source files and their stats
+};
+
+staticdb_t *staticdb_create   (const char *path,
+                               char * const *sources, size_t count);
+void        staticdb_delete   (staticdb_t *self);
+int         staticdb_load     (const staticdb_t *self, inifile_t *ini);
+int         staticdb_save     (const staticdb_t *self, const inifile_t *ini);
+int         staticdb_parse    (inifile_t *ini,
+                               char * const *sources, size_t count);
+
+# ifdef __cplusplus
+};
+# endif
+
+#endif /* STATICDB_H_ */
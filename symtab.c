@@ -36,10 +36,187 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <time.h>
 
 #include "symtab.h"
+#include "atom.h"
+
+/* ========================================================================= *
+ * symtab_t  --  hash index
+ * ========================================================================= */
+
+enum
+{
+  SYMTAB_MIN_SLOTS = 16, // initial hash index size
+};
+
+/* ------------------------------------------------------------------------- *
+ * symtab_hash  --  FNV-1a hash for key strings
+ * ------------------------------------------------------------------------- */
+
+size_t
+symtab_hash(const char *key)
+{
+  uint32_t h = 2166136261u;
+
+  for( const unsigned char *s = (const unsigned char *)key; *s; ++s )
+  {
+    h ^= *s;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_keyhash  --  hash value for element key
+ * ------------------------------------------------------------------------- */
+
+static inline size_t
+symtab_keyhash(const symtab_t *self, const char *key)
+{
+  return self->st_atoms ? atom_hash(key) : symtab_hash(key);
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_keysame  --  compare element keys
+ * ------------------------------------------------------------------------- */
+
+static inline int
+symtab_keysame(const symtab_t *self, const char *a, const char *b)
+{
+  return self->st_atoms ? (a == b) : !strcmp(a, b);
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_new_elem  --  create element for key
+ * ------------------------------------------------------------------------- */
+
+static inline void *
+symtab_new_elem(const symtab_t *self, const char *key)
+{
+  if( self->st_new_ctx != 0 )
+  {
+    return self->st_new_ctx(self->st_ctx, key);
+  }
+  return self->st_new(key);
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_probe  --  locate slot that holds key, or empty slot for it
+ * ------------------------------------------------------------------------- */
+
+static size_t
+symtab_probe(const symtab_t *self, const char *key)
+{
+  size_t mask = self->st_slots - 1;
+  size_t slot = symtab_keyhash(self, key) & mask;
+
+  for( ;; slot = (slot + 1) & mask )
+  {
+    size_t i = self->st_index[slot];
+
+    if( i == 0 )
+    {
+      break;
+    }
+
+    if( symtab_keysame(self, self->st_key(self->st_elem[i-1]), key) )
+    {
+      break;
+    }
+  }
+  return slot;
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_rehash  --  rebuild hash index with given number of slots
+ * ------------------------------------------------------------------------- */
+
+static void
+symtab_rehash(symtab_t *self, size_t slots)
+{
+  free(self->st_index);
+
+  self->st_slots = slots;
+  self->st_index = calloc(slots, sizeof *self->st_index);
+
+  for( size_t i = 0; i < self->st_indexed; ++i )
+  {
+    const char *key = self->st_key(self->st_elem[i]);
+    self->st_index[symtab_probe(self, key)] = i + 1;
+  }
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_unlink  --  remove hash slot, shift colliding entries back
+ * ------------------------------------------------------------------------- */
+
+static void
+symtab_unlink(symtab_t *self, size_t slot)
+{
+  size_t mask = self->st_slots - 1;
+  size_t hole = slot;
+
+  for( ;; )
+  {
+    slot = (slot + 1) & mask;
+
+    size_t i = self->st_index[slot];
+
+    if( i == 0 )
+    {
+      break;
+    }
+
+    const char *key  = self->st_key(self->st_elem[i-1]);
+    size_t      home = symtab_keyhash(self, key) & mask;
+
+    /* entries whose home slot is cyclically within (hole, slot]
+     * are still reachable and must not be moved */
+    if( hole <= slot ? (hole < home && home <= slot)
+                     : (hole < home || home <= slot) )
+    {
+      continue;
+    }
+
+    self->st_index[hole] = i;
+    hole = slot;
+  }
+
+  self->st_index[hole] = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_reserve  --  make room for hash index and element array
+ * ------------------------------------------------------------------------- */
+
+static void
+symtab_reserve(symtab_t *self, size_t count)
+{
+  /* keep hash index load factor below 3/4 */
+  if( count * 4 > self->st_slots * 3 )
+  {
+    size_t slots = self->st_slots ? self->st_slots : SYMTAB_MIN_SLOTS;
+    while( count * 4 > slots * 3 ) slots *= 2;
+    symtab_rehash(self, slots);
+  }
+
+  if( count > self->st_alloc )
+  {
+    if( self->st_alloc < 16 )
+    {
+      self->st_alloc = 16;
+    }
+    while( self->st_alloc < count )
+    {
+      self->st_alloc = self->st_alloc * 3 / 2;
+    }
+    self->st_elem = realloc(self->st_elem,
+                            self->st_alloc * sizeof *self->st_elem);
+  }
+}
 
 /* ========================================================================= *
  * symtab_t  --  methods
@@ -52,20 +229,45 @@
 void *
 symtab_insert(symtab_t *self, const void *key)
 {
-  size_t l = 0;
-  size_t h = self->st_count;
+  void       *res = 0;
+  const char *tmp = 0;
+
+  symtab_reindex(self);
+  symtab_reserve(self, self->st_count + 1);
 
-  while( l < h )
+  if( self->st_atoms )
   {
-    size_t i = (l + h) / 2;
-    void  *p = self->st_elem[i];
-    int    r = strcmp(self->st_key(p), key);
+    key = tmp = atom_intern(key);
+  }
+
+  size_t slot = symtab_probe(self, key);
 
-    if( r < 0 ) { l = i + 1; continue; }
-    if( r > 0 ) { h = i + 0; continue; }
-    return p;
+  if( self->st_index[slot] != 0 )
+  {
+    res = self->st_elem[self->st_index[slot] - 1];
   }
+  else
+  {
+    res = self->st_elem[self->st_count] = symtab_new_elem(self, key);
+    self->st_index[slot] = ++self->st_count;
+    self->st_indexed = self->st_count;
+  }
+
+  atom_release(tmp);
 
+  return res;
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_append  --  add element without hash index update
+ *
+ * Duplicate keys are allowed; they are resolved by symtab_reindex()
+ * so that the last appended element replaces the earlier ones.
+ * ------------------------------------------------------------------------- */
+
+void *
+symtab_append(symtab_t *self, const void *key)
+{
   if( self->st_count == self->st_alloc )
   {
     if( self->st_alloc < 16 )
@@ -80,12 +282,47 @@ symtab_insert(symtab_t *self, const void *key)
                             self->st_alloc * sizeof *self->st_elem);
   }
 
-  for( h = self->st_count++; h > l; --h )
+  return self->st_elem[self->st_count++] = symtab_new_elem(self, key);
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_reindex  --  add appended elements to hash index
+ *
+ * Later duplicates replace earlier elements in place, so the element
+ * keeps the position where the key was first seen.
+ * ------------------------------------------------------------------------- */
+
+void
+symtab_reindex(symtab_t *self)
+{
+  if( self->st_indexed == self->st_count )
   {
-    self->st_elem[h] = self->st_elem[h-1];
+    return;
   }
 
-  return self->st_elem[l] = self->st_new(key);
+  symtab_reserve(self, self->st_count);
+
+  size_t n = self->st_indexed;
+
+  for( size_t i = self->st_indexed; i < self->st_count; ++i )
+  {
+    void  *p    = self->st_elem[i];
+    size_t slot = symtab_probe(self, self->st_key(p));
+    size_t j    = self->st_index[slot];
+
+    if( j != 0 )
+    {
+      self->st_del(self->st_elem[j-1]);
+      self->st_elem[j-1] = p;
+    }
+    else
+    {
+      self->st_elem[n] = p;
+      self->st_index[slot] = ++n;
+    }
+  }
+
+  self->st_count = self->st_indexed = n;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -95,20 +332,30 @@ symtab_insert(symtab_t *self, const void *key)
 void *
 symtab_lookup(const symtab_t *self, const void *key)
 {
-  size_t l = 0;
-  size_t h = self->st_count;
-
-  while( l < h )
+  /* strings that are not atoms can not be keys either */
+  if( self->st_atoms && (key = atom_find(key)) == 0 )
   {
-    size_t i = (l + h) / 2;
-    void  *p = self->st_elem[i];
-    int    r = strcmp(self->st_key(p), key);
+    return 0;
+  }
 
-    if( r < 0 ) { l = i + 1; continue; }
-    if( r > 0 ) { h = i + 0; continue; }
-    return p;
+  /* appended elements override indexed ones, latest first */
+  for( size_t i = self->st_count; i-- > self->st_indexed; )
+  {
+    if( symtab_keysame(self, self->st_key(self->st_elem[i]), key) )
+    {
+      return self->st_elem[i];
+    }
   }
 
+  if( self->st_indexed != 0 )
+  {
+    size_t i = self->st_index[symtab_probe(self, key)];
+
+    if( i != 0 )
+    {
+      return self->st_elem[i-1];
+    }
+  }
   return 0;
 }
 
@@ -119,26 +366,76 @@ symtab_lookup(const symtab_t *self, const void *key)
 void
 symtab_remove(symtab_t *self, const void *key)
 {
-  size_t l = 0;
-  size_t h = self->st_count;
+  symtab_reindex(self);
+
+  if( self->st_count == 0 )
+  {
+    return;
+  }
 
-  while( l < h )
+  if( self->st_atoms && (key = atom_find(key)) == 0 )
   {
-    size_t i = (l + h) / 2;
-    void  *p = self->st_elem[i];
-    int    r = strcmp(self->st_key(p), key);
+    return;
+  }
 
-    if( r < 0 ) { l = i + 1; continue; }
-    if( r > 0 ) { h = i + 0; continue; }
+  size_t slot = symtab_probe(self, key);
+  size_t i    = self->st_index[slot];
 
-    self->st_del(p);
+  if( i == 0 )
+  {
+    return;
+  }
 
-    for( h = --self->st_count; i < h; ++i )
-    {
-      self->st_elem[i] = self->st_elem[i+1];
-    }
-    break;
+  void *p = self->st_elem[--i];
+
+  symtab_unlink(self, slot);
+
+  /* fill the gap in element array with the last element */
+  if( i != --self->st_count )
+  {
+    void *last = self->st_elem[self->st_count];
+
+    self->st_elem[i] = last;
+    self->st_index[symtab_probe(self, self->st_key(last))] = i + 1;
   }
+  self->st_indexed = self->st_count;
+
+  self->st_del(p);
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_sorted_cb  --  qsort_r callback for ordering elements by key
+ * ------------------------------------------------------------------------- */
+
+static
+int
+symtab_sorted_cb(const void *a, const void *b, void *aptr)
+{
+  const symtab_t *self = aptr;
+  return strcmp(self->st_key(*(void * const *)a),
+                self->st_key(*(void * const *)b));
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_sorted  --  get elements in key order
+ *
+ * Returns NULL terminated array that must be released with free().
+ * ------------------------------------------------------------------------- */
+
+void **
+symtab_sorted(const symtab_t *self)
+{
+  void **res = malloc((self->st_count + 1) * sizeof *res);
+
+  if( self->st_count != 0 )
+  {
+    memcpy(res, self->st_elem, self->st_count * sizeof *res);
+    qsort_r(res, self->st_count, sizeof *res, symtab_sorted_cb,
+            (void *)self);
+  }
+  res[self->st_count] = 0;
+
+  return res;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -155,7 +452,13 @@ symtab_clear(symtab_t *self)
       self->st_del(self->st_elem[i]);
     }
   }
-  self->st_count = 0;
+  self->st_count   = 0;
+  self->st_indexed = 0;
+
+  if( self->st_index != 0 )
+  {
+    memset(self->st_index, 0, self->st_slots * sizeof *self->st_index);
+  }
 }
 
 /* ------------------------------------------------------------------------- *
@@ -171,9 +474,48 @@ symtab_ctor(symtab_t *self,
   self->st_count = 0;
   self->st_alloc = 0;
   self->st_elem  = 0;
+  self->st_slots = 0;
+  self->st_index = 0;
+  self->st_indexed = 0;
+  self->st_atoms = 0;
   self->st_new   = new;
   self->st_key   = key;
   self->st_del   = del;
+  self->st_new_ctx = 0;
+  self->st_ctx     = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_ctor_atoms  --  symbol table for elements with atom keys
+ *
+ * Element keys returned by st_key must be atoms, see atom.h. Lookups
+ * then need just one hash lookup of the key string and the hash index
+ * uses pointer comparisons only.
+ * ------------------------------------------------------------------------- */
+
+void
+symtab_ctor_atoms(symtab_t *self,
+                  symtab_new_fn new,
+                  symtab_del_fn del,
+                  symtab_key_fn key)
+{
+  symtab_ctor(self, new, del, key);
+  self->st_atoms = 1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * symtab_set_context  --  create elements with context, e.g. from arena
+ * ------------------------------------------------------------------------- */
+
+void
+symtab_set_context(symtab_t *self,
+                   symtab_new_ctx_fn new,
+                   symtab_del_fn del,
+                   void *ctx)
+{
+  self->st_new_ctx = new;
+  self->st_del     = del;
+  self->st_ctx     = ctx;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -185,6 +527,7 @@ symtab_dtor(symtab_t *self)
 {
   symtab_clear(self);
   free(self->st_elem);
+  free(self->st_index);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -201,6 +544,20 @@ symtab_create(symtab_new_fn new,
   return self;
 }
 
+/* ------------------------------------------------------------------------- *
+ * symtab_create_atoms
+ * ------------------------------------------------------------------------- */
+
+symtab_t *
+symtab_create_atoms(symtab_new_fn new,
+                    symtab_del_fn del,
+                    symtab_key_fn key)
+{
+  symtab_t *self = calloc(1, sizeof *self);
+  symtab_ctor_atoms(self, new, del, key);
+  return self;
+}
+
 /* ------------------------------------------------------------------------- *
  * symtab_delete
  * ------------------------------------------------------------------------- */
@@ -43,6 +43,7 @@ extern "C" {
 typedef struct symtab_t symtab_t;
 
 typedef void       *(*symtab_new_fn)(const char*);
+typedef void       *(*symtab_new_ctx_fn)(void*, const char*);
 typedef const char *(*symtab_key_fn)(const void*);
 typedef void        (*symtab_del_fn)(void*);
 
@@ -50,29 +51,64 @@ typedef void        (*symtab_del_fn)(void*);
  * symtab_t
  * ------------------------------------------------------------------------- */
 
+/* Elements are kept in st_elem array in unspecified order, lookups
+ * are done via open addressing hash index that maps key hashes to
+ * positions in the element array. Use symtab_sorted() when the
+ * elements need to be processed in key order.
+ *
+ * Bulk loads can use symtab_append() that skips the hash index, the
+ * appended elements are merged to the index by symtab_reindex().
+ *
+ * Elements are normally created with st_new. If st_new_ctx is set
+ * via symtab_set_context(), it is used instead and gets st_ctx as
+ * the first argument, e.g. for allocating elements from an arena. */
+
 struct symtab_t
 {
   size_t  st_count;
   size_t  st_alloc;
   void  **st_elem;
 
+  size_t  st_slots;   // size of hash index, zero or power of two
+  size_t *st_index;   // element position + 1, or zero for unused slot
+  size_t  st_indexed; // elements [0, st_indexed) are in hash index
+  int     st_atoms;   // element keys are atoms, see symtab_ctor_atoms()
+
   symtab_new_fn  st_new;
   symtab_del_fn  st_del;
   symtab_key_fn  st_key;
+
+  symtab_new_ctx_fn st_new_ctx;
+  void             *st_ctx;
 };
 
+size_t    symtab_hash     (const char *key);
 void     *symtab_insert   (symtab_t *self, const void *key);
+void     *symtab_append   (symtab_t *self, const void *key);
+void      symtab_reindex  (symtab_t *self);
 void     *symtab_lookup   (const symtab_t *self, const void *key);
 void      symtab_remove   (symtab_t *self, const void *key);
+void    **symtab_sorted   (const symtab_t *self);
 void      symtab_clear    (symtab_t *self);
 void      symtab_ctor     (symtab_t *self,
                            symtab_new_fn new,
                            symtab_del_fn del,
                            symtab_key_fn key);
+void      symtab_ctor_atoms(symtab_t *self,
+                           symtab_new_fn new,
+                           symtab_del_fn del,
+                           symtab_key_fn key);
+void      symtab_set_context(symtab_t *self,
+                             symtab_new_ctx_fn new,
+                             symtab_del_fn del,
+                             void *ctx);
 void      symtab_dtor     (symtab_t *self);
 symtab_t *symtab_create   (symtab_new_fn new,
                            symtab_del_fn del,
                            symtab_key_fn key);
+symtab_t *symtab_create_atoms(symtab_new_fn new,
+                              symtab_del_fn del,
+                              symtab_key_fn key);
 void      symtab_delete   (symtab_t *self);
 void      symtab_delete_cb(void *self);
 
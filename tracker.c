@@ -58,6 +58,13 @@
   ",interface='"PROFILED_INTERFACE"'"\
   ",member='"PROFILED_CHANGED"'"
 
+#define PROFILED_OWNER_MATCH \
+  "type='signal'"\
+  ",sender='"DBUS_SERVICE_DBUS"'"\
+  ",interface='"DBUS_INTERFACE_DBUS"'"\
+  ",member='NameOwnerChanged'"\
+  ",arg0='"PROFILED_SERVICE"'"
+
 /* ========================================================================= *
  * Callback Array Handling
  * ========================================================================= */
@@ -355,6 +362,7 @@ profile_tracker_filter(DBusConnection *conn,
 
     if( changed != 0 )
     {
+      profile_cache_set_active(profile);
       profile_track_profile(profile);
     }
 
@@ -364,6 +372,8 @@ profile_tracker_filter(DBusConnection *conn,
 
     while( decode_triplet(&item, &key,&val,&type) == 0 )
     {
+      profile_cache_set_value(profile, key,val,type);
+
       if( active != 0 )
       {
         profile_track_active(profile, key,val,type);
@@ -374,6 +384,13 @@ profile_tracker_filter(DBusConnection *conn,
       }
     }
   }
+  else if( type == DBUS_MESSAGE_TYPE_SIGNAL &&
+           !strcmp(interface, DBUS_INTERFACE_DBUS) &&
+           !strcmp(member, "NameOwnerChanged") )
+  {
+    /* profiled started or stopped -> cached data is not valid */
+    profile_cache_flush();
+  }
 
   cleanup:
 
@@ -403,6 +420,15 @@ profile_tracker_disconnect(void)
 		err.name, err.message);
 	dbus_error_free(&err);
       }
+
+      dbus_bus_remove_match(profile_tracker_con, PROFILED_OWNER_MATCH, &err);
+
+      if( dbus_error_is_set(&err) )
+      {
+	log_err("%s: %s: %s\n", "dbus_bus_remove_match",
+		err.name, err.message);
+	dbus_error_free(&err);
+      }
     }
 
     /* remove message filter function */
@@ -415,6 +441,9 @@ profile_tracker_disconnect(void)
     LEAVE
   }
 
+  /* no signals -> cached data can not be kept up to date */
+  profile_cache_flush();
+
   dbus_error_free(&err);
 }
 
@@ -464,6 +493,16 @@ profile_tracker_connect(void)
     goto cleanup;
   }
 
+  /* Listen to profiled restarts, for invalidating cached data */
+  dbus_bus_add_match(profile_tracker_con, PROFILED_OWNER_MATCH, &err);
+
+  if( dbus_error_is_set(&err) )
+  {
+    log_err("%s: %s: %s\n", "dbus_bus_add_match",
+            err.name, err.message);
+    goto cleanup;
+  }
+
   /* Success */
   res = 0;
 
@@ -498,6 +537,16 @@ profile_tracker_reconnect(void)
   LEAVE
 }
 
+/* ------------------------------------------------------------------------- *
+ * profile_tracker_is_connected  --  are change signals being received
+ * ------------------------------------------------------------------------- */
+
+int
+profile_tracker_is_connected(void)
+{
+  return profile_tracker_con != 0;
+}
+
 /* ========================================================================= *
  * API Functions
  * ========================================================================= */
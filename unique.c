@@ -193,3 +193,32 @@ unique_add(unique_t *self, const char *str)
   self->un_string[self->un_count] = 0;
   self->un_dirty = 1;
 }
+
+/* ------------------------------------------------------------------------- *
+ * unique_remove
+ * ------------------------------------------------------------------------- */
+
+void
+unique_remove(unique_t *self, const char *str)
+{
+  size_t si = 0, di = 0;
+
+  while( si < self->un_count )
+  {
+    char *curr = self->un_string[si++];
+    if( strcmp(curr, str ?: "") )
+    {
+      self->un_string[di++] = curr;
+    }
+    else
+    {
+      free(curr);
+    }
+  }
+
+  if( self->un_string != 0 )
+  {
+    self->un_count = di;
+    self->un_string[self->un_count] = 0;
+  }
+}
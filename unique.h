@@ -64,6 +64,7 @@ void       unique_delete_cb(void *self);
 char     **unique_final    (unique_t *self, size_t *pcount);
 char     **unique_steal    (unique_t *self, size_t *pcount);
 void       unique_add      (unique_t *self, const char *str);
+void       unique_remove   (unique_t *self, const char *str);
 
 # ifdef __cplusplus
 };
@@ -106,6 +106,30 @@ xloadfile(const char *path, char **pdata, size_t *psize)
   return err;
 }
 
+/* ------------------------------------------------------------------------- *
+ * xwritefile  --  write whole buffer to open file
+ * ------------------------------------------------------------------------- */
+
+static int
+xwritefile(int file, const char *path, const void *data, size_t size)
+{
+  const char *base = data;
+  size_t done = 0;
+  while( done < size )
+  {
+    errno = 0;
+    int n = TEMP_FAILURE_RETRY(write(file, base+done, size-done));
+    if( n <= 0 )
+    {
+      log_err("%s: save/write: %s (%Zd/%Zd)\n", path, strerror(errno),
+              done, size);
+      return -1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
 /* ------------------------------------------------------------------------- *
  * xsavefile  --  save buffer to file
  * ------------------------------------------------------------------------- */
@@ -126,19 +150,9 @@ xsavefile(const char *path, int mode, const void *data, size_t size)
     }
   }
 
-  const char *base = data;
-  size_t done = 0;
-  while( done < size )
+  if( xwritefile(file, path, data, size) == -1 )
   {
-    errno = 0;
-    int n = TEMP_FAILURE_RETRY(write(file, base+done, size-done));
-    if( n <= 0 )
-    {
-      log_err("%s: save/write: %s (%Zd/%Zd)\n", path, strerror(errno),
-              done, size);
-      goto cleanup;
-    }
-    done += n;
+    goto cleanup;
   }
 
   if( ftruncate(file, size) == -1 )
@@ -168,57 +182,251 @@ xsavefile(const char *path, int mode, const void *data, size_t size)
 }
 
 /* ------------------------------------------------------------------------- *
- * xcyclefiles  --  rename: temp -> current -> backup
+ * xdirname  --  directory part of path, caller must free
+ * ------------------------------------------------------------------------- */
+
+char *
+xdirname(const char *path)
+{
+  const char *end = strrchr(path, '/');
+
+  if( end == 0 )   return strdup(".");
+  if( end == path ) return strdup("/");
+  return strndup(path, end - path);
+}
+
+/* ------------------------------------------------------------------------- *
+ * xsyncdir  --  make renames and links in a directory durable
  * ------------------------------------------------------------------------- */
 
 int
-xcyclefiles(const char *temp, const char *path, const char *back)
+xsyncdir(const char *path)
 {
-  /* - - - - - - - - - - - - - - - - - - - *
-   * not foolproof, but certainly better
-   * than directly overwriting datafiles
-   * - - - - - - - - - - - - - - - - - - - */
+  int err  = -1;
+  int file = -1;
 
-  int err = -1;
+  if( (file = open(path, O_RDONLY|O_DIRECTORY)) == -1 )
+  {
+    log_err("%s: sync/open: %s\n", path, strerror(errno));
+    goto cleanup;
+  }
 
-  if( !xexists(temp) )
+  if( fsync(file) == -1 )
   {
-    log_warning("%s: missing new file: %s\n", temp, strerror(errno));
-    goto done;
+    log_err("%s: sync/fsync: %s\n", path, strerror(errno));
+    goto cleanup;
   }
 
-  if( xexists(path) )
+  err = 0;
+
+  cleanup:
+
+  if( file != -1 ) close(file);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * xstagetmpfile  --  write unnamed file and link it as the temporary file
+ *
+ * The temporary file only appears once its content is complete and on
+ * disk. Returns -1 without logging if O_TMPFILE can not be used, so
+ * that the caller can fall back to writing the named file directly.
+ * ------------------------------------------------------------------------- */
+
+static int
+xstagetmpfile(xcommit_t *self, int mode, const void *data, size_t size)
+{
+  int   err  = -1;
+  int   file = -1;
+  char *dir  = xdirname(self->xc_work);
+
+#ifdef O_TMPFILE
+  char proc[64];
+
+  if( dir == 0 || (file = open(dir, O_TMPFILE|O_WRONLY, mode)) == -1 )
   {
-    // backup -> /dev/null
-    remove(back);
+    // not supported by kernel or file system
+    goto cleanup;
+  }
 
-    // current -> backup
-    if( rename(path, back) == -1 )
-    {
-      log_err("rename %s -> %s: %s\n", path, back, strerror(errno));
-      goto done;
-    }
+  if( xwritefile(file, self->xc_work, data, size) == -1 ||
+      fdatasync(file) == -1 )
+  {
+    goto cleanup;
   }
 
-  // temporary -> current
-  if( rename(temp, path) == -1 )
+  // linkat() fails if the name exists
+  if( remove(self->xc_work) == -1 && errno != ENOENT )
   {
-    log_err("rename %s -> %s: %s\n", temp, path, strerror(errno));
+    goto cleanup;
+  }
 
-    // try backup -> current
-    if( xexists(back) )
-    {
-      rename(back, path);
-    }
-    goto done;
+  snprintf(proc, sizeof proc, "/proc/self/fd/%d", file);
+
+  if( linkat(AT_FDCWD, proc, AT_FDCWD, self->xc_work,
+             AT_SYMLINK_FOLLOW) == -1 &&
+      linkat(file, "", AT_FDCWD, self->xc_work, AT_EMPTY_PATH) == -1 )
+  {
+    goto cleanup;
   }
 
-  // success
   err = 0;
 
-  done:
+  cleanup:
+#else
+  (void)mode, (void)data, (void)size;
+#endif
+
+  if( file != -1 ) close(file);
+  free(dir);
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * xstagefile  --  write new content for a data file to its temporary file
+ *
+ * The data file itself is not touched until xcommitfiles().
+ * ------------------------------------------------------------------------- */
+
+int
+xstagefile(xcommit_t *self, int mode, const void *data, size_t size)
+{
+  int err  = -1;
+  int file = -1;
+
+  self->xc_ready = 0;
+
+  if( xstagetmpfile(self, mode, data, size) == 0 )
+  {
+    self->xc_ready = 1;
+    return 0;
+  }
+
+  /* The temporary file can be a hard link to the data file or the
+   * backup file, so it must be removed instead of overwritten */
+
+  if( remove(self->xc_work) == -1 && errno != ENOENT )
+  {
+    log_err("%s: stage/remove: %s\n", self->xc_work, strerror(errno));
+    goto cleanup;
+  }
+
+  if( (file = open(self->xc_work, O_WRONLY|O_CREAT|O_EXCL, mode)) == -1 )
+  {
+    log_err("%s: stage/open: %s\n", self->xc_work, strerror(errno));
+    goto cleanup;
+  }
+
+  if( xwritefile(file, self->xc_work, data, size) == -1 )
+  {
+    goto cleanup;
+  }
+
+  if( fdatasync(file) == -1 )
+  {
+    log_err("%s: stage/fdatasync: %s\n", self->xc_work, strerror(errno));
+    goto cleanup;
+  }
+
+  err = 0;
+
+  cleanup:
+
+  if( file != -1 && close(file) == -1 )
+  {
+    log_err("%s: stage/close: %s\n", self->xc_work, strerror(errno));
+    err = -1;
+  }
+
+  if( err == 0 )
+  {
+    self->xc_ready = 1;
+  }
+  else if( file != -1 )
+  {
+    remove(self->xc_work);
+  }
+
+  return err;
+}
+
+/* ------------------------------------------------------------------------- *
+ * xcommitfiles  --  replace data files with staged content
+ *
+ * Each data file is replaced with one rename, so it always exists with
+ * either the old or the new content. The old content is kept as backup
+ * via a hard link made before the rename. The directory entries of all
+ * files are made durable with one fsync per directory, normally just
+ * one for the whole commit.
+ * ------------------------------------------------------------------------- */
+
+int
+xcommitfiles(xcommit_t *const *files, size_t count)
+{
+  int    err  = 0;
+  size_t ndir = 0;
+  char  *dirs[count ?: 1];
+
+  for( size_t i = 0; i < count; ++i )
+  {
+    xcommit_t *self = files[i];
+    int        had  = 0;
+
+    if( !self->xc_ready )
+    {
+      continue;
+    }
+    self->xc_ready = 0;
+
+    // old data file -> backup, without a moment of missing data file
+    if( self->xc_back != 0 )
+    {
+      remove(self->xc_back);
+      had = (link(self->xc_path, self->xc_back) == 0);
+    }
+
+    // temporary -> data file
+    if( rename(self->xc_work, self->xc_path) == -1 )
+    {
+      log_err("rename %s -> %s: %s\n", self->xc_work, self->xc_path,
+              strerror(errno));
+      err = -1;
+      continue;
+    }
+
+    // first save: backup starts out as a copy of the new content
+    if( self->xc_back != 0 && !had )
+    {
+      link(self->xc_path, self->xc_back);
+    }
+
+    char  *dir = xdirname(self->xc_path);
+    size_t k   = 0;
+
+    if( dir == 0 )
+    {
+      err = -1;
+      continue;
+    }
+    while( k < ndir && strcmp(dirs[k], dir) ) ++k;
+
+    if( k < ndir )
+      free(dir);
+    else
+      dirs[ndir++] = dir;
+  }
+
+  for( size_t k = 0; k < ndir; ++k )
+  {
+    if( xsyncdir(dirs[k]) == -1 )
+    {
+      err = -1;
+    }
+    free(dirs[k]);
+  }
 
-  //log_crit_F("error=%d\n", err);
   return err;
 }
 
@@ -259,6 +467,23 @@ xcheckstats(const char *path, const struct stat *old)
   return ok;
 }
 
+/* ------------------------------------------------------------------------- *
+ * xhash  --  FNV-1a hash over memory block
+ * ------------------------------------------------------------------------- */
+
+uint32_t
+xhash(const void *data, size_t size)
+{
+  const unsigned char *pos = data;
+  uint32_t             res = 2166136261u;
+
+  for( size_t i = 0; i < size; ++i )
+  {
+    res = (res ^ pos[i]) * 16777619u;
+  }
+  return res;
+}
+
 /* ------------------------------------------------------------------------- *
  * xstrfmt  --  bit like asprintf, but without undefined state on error
  * ------------------------------------------------------------------------- */
@@ -39,6 +39,7 @@
 
 # include <stdlib.h>
 # include <string.h>
+# include <stdint.h>
 
 # ifdef __cplusplus
 extern "C" {
@@ -46,12 +47,28 @@ extern "C" {
 } /* fool JED indentation ... */
 # endif
 
+/* ------------------------------------------------------------------------- *
+ * xcommit_t  --  data file update staged for xcommitfiles()
+ * ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  const char *xc_path;   // data file
+  const char *xc_work;   // temporary file, same directory as data file
+  const char *xc_back;   // backup file, or NULL
+  int         xc_ready;  // temporary file written and synced
+} xcommit_t;
+
 int  xexists(const char *path);
 int  xloadfile(const char *path, char **pdata, size_t *psize);
 int  xsavefile(const char *path, int mode, const void *data, size_t size);
-int  xcyclefiles(const char *temp, const char *path, const char *back);
+int  xstagefile(xcommit_t *self, int mode, const void *data, size_t size);
+int  xcommitfiles(xcommit_t *const *files, size_t count);
+char *xdirname(const char *path);
+int  xsyncdir(const char *path);
 void xfetchstats(const char *path, struct stat *cur);
 int  xcheckstats(const char *path, const struct stat *old);
+uint32_t xhash(const void *data, size_t size);
 char *xstrfmt(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 
 static inline int xiswhite(int c)